@@ -0,0 +1,195 @@
+#include "board.h"
+#include "frame_diff.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _MSC_VER
+  #include <intrin.h>
+#endif
+
+// Index of the lowest set bit, word must be non-zero
+static int lowestSetBit(uint64_t word)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, word);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(word);
+#endif
+}
+
+Board::Board() : width(0), height(0), chunksWide(0), chunksHigh(0), allocatedChunks(0), dirtyCount(0), allDirty(false), deltaMode(DeltaMode::DirtyMask), pendingDiff(false) {}
+
+void Board::setDeltaMode(DeltaMode mode) {
+  deltaMode = mode;
+}
+
+void Board::resize(int cols, int rows) {
+  width = cols;
+  height = rows;
+  chunksWide = (cols + CHUNK_MASK) >> CHUNK_SHIFT;
+  chunksHigh = (rows + CHUNK_MASK) >> CHUNK_SHIFT;
+  chunks.clear();
+  chunks.resize(static_cast<size_t>(chunksWide) * chunksHigh);
+  versions.assign(chunks.size(), 0);
+  reset();
+}
+
+// Frees every chunk, which turns the whole board back into background
+void Board::reset() {
+  for (size_t i = 0; i < chunks.size(); i++) {
+    chunks[i].reset();
+    versions[i]++;
+  }
+  allocatedChunks = 0;
+  allDirty = true;
+  pendingDiff = false;
+  dirtyCount = static_cast<size_t>(width) * height;
+}
+
+BoardChunk* Board::allocateChunk(int cx, int cy) {
+  std::unique_ptr<BoardChunk>& slot = chunks[chunkIndex(cx, cy)];
+  slot = std::make_unique<BoardChunk>();
+  std::memset(slot->tiles, BACKGROUND_COLOR, sizeof(slot->tiles));
+  std::memset(slot->dirty, 0, sizeof(slot->dirty));
+  slot->dirtyCount = 0;
+  if (deltaMode == DeltaMode::FrameDiff) {
+    // Clients last saw this chunk as background
+    slot->previous = std::make_unique<ColorIndex[]>(CHUNK_AREA);
+    std::memset(slot->previous.get(), BACKGROUND_COLOR, CHUNK_AREA);
+  }
+  slot->previousVersion = versions[chunkIndex(cx, cy)];
+  allocatedChunks++;
+  return slot.get();
+}
+
+void Board::set(int x, int y, ColorIndex color) {
+  int cx = x >> CHUNK_SHIFT;
+  int cy = y >> CHUNK_SHIFT;
+  BoardChunk* chunk = chunks[chunkIndex(cx, cy)].get();
+  if (!chunk) {
+    // Unallocated chunks already read as background
+    if (color == BACKGROUND_COLOR) return;
+    chunk = allocateChunk(cx, cy);
+  }
+
+  int localY = y & CHUNK_MASK;
+  int localX = x & CHUNK_MASK;
+  chunk->tiles[(localY << CHUNK_SHIFT) | localX] = color;
+  versions[chunkIndex(cx, cy)]++;
+  if (deltaMode == DeltaMode::FrameDiff) {
+    pendingDiff = true;
+    return;
+  }
+
+  uint64_t bit = uint64_t(1) << localX;
+  dirtyStats.writes++;
+  if (chunk->dirty[localY] & bit) {
+    dirtyStats.coalesced++;
+  } else {
+    chunk->dirty[localY] |= bit;
+    chunk->dirtyCount++;
+    dirtyCount++;
+  }
+}
+
+// Copies one full board row into out, which must hold cols() tiles
+void Board::copyRow(int y, ColorIndex* out) const {
+  int cy = y >> CHUNK_SHIFT;
+  int localY = y & CHUNK_MASK;
+  for (int cx = 0; cx < chunksWide; cx++) {
+    int x = cx << CHUNK_SHIFT;
+    int count = std::min(CHUNK_SIZE, width - x);
+    const BoardChunk* chunk = chunks[chunkIndex(cx, cy)].get();
+    if (chunk) {
+      std::memcpy(out + x, chunk->tiles + (localY << CHUNK_SHIFT), count);
+    } else {
+      std::memset(out + x, BACKGROUND_COLOR, count);
+    }
+  }
+}
+
+const ColorIndex* Board::chunkTiles(int cx, int cy) const {
+  const BoardChunk* chunk = chunks[chunkIndex(cx, cy)].get();
+  return chunk ? chunk->tiles : nullptr;
+}
+
+// Emits every tile after a reset and brings all tracking state up to date
+void Board::collectAllTiles(std::vector<Tile>& out) {
+  std::vector<ColorIndex> row(width);
+  out.reserve(out.size() + static_cast<size_t>(width) * height);
+  for (int y = 0; y < height; y++) {
+    copyRow(y, row.data());
+    for (int x = 0; x < width; x++) {
+      out.push_back({ x, y, row[x] });
+    }
+  }
+  for (size_t i = 0; i < chunks.size(); i++) {
+    BoardChunk* chunk = chunks[i].get();
+    if (!chunk) continue;
+    std::memset(chunk->dirty, 0, sizeof(chunk->dirty));
+    chunk->dirtyCount = 0;
+    if (chunk->previous) {
+      std::memcpy(chunk->previous.get(), chunk->tiles, CHUNK_AREA);
+    }
+    chunk->previousVersion = versions[i];
+  }
+}
+
+// Appends every changed tile in row-major order and clears the tracking
+// state. Only chunks with pending changes are visited, one band of chunk
+// rows at a time. The changed bits of a chunk row come either from the
+// dirty mask or from a vectorized compare with last tick's copy.
+void Board::collectDirtyTiles(std::vector<Tile>& out) {
+  size_t first = out.size();
+  bool diff = deltaMode == DeltaMode::FrameDiff;
+
+  if (allDirty) {
+    collectAllTiles(out);
+  } else {
+    out.reserve(first + dirtyCount);
+    for (int cy = 0; cy < chunksHigh; cy++) {
+      dirtyBand.clear();
+      for (int cx = 0; cx < chunksWide; cx++) {
+        const BoardChunk* chunk = chunks[chunkIndex(cx, cy)].get();
+        if (!chunk) continue;
+        bool touched = diff ? chunk->previousVersion != versions[chunkIndex(cx, cy)] : chunk->dirtyCount > 0;
+        if (touched) {
+          dirtyBand.push_back(cx);
+        }
+      }
+      if (dirtyBand.empty()) continue;
+
+      for (int localY = 0; localY < CHUNK_SIZE; localY++) {
+        int y = (cy << CHUNK_SHIFT) + localY;
+        if (y >= height) break;
+        int rowOffset = localY << CHUNK_SHIFT;
+        for (int cx : dirtyBand) {
+          BoardChunk* chunk = chunks[chunkIndex(cx, cy)].get();
+          uint64_t word = diff ? diffChunkRow(chunk->tiles + rowOffset, chunk->previous.get() + rowOffset) : chunk->dirty[localY];
+          while (word) {
+            int localX = lowestSetBit(word);
+            out.push_back({ (cx << CHUNK_SHIFT) + localX, y, chunk->tiles[(localY << CHUNK_SHIFT) | localX] });
+            word &= word - 1;
+          }
+          chunk->dirty[localY] = 0;
+        }
+      }
+      for (int cx : dirtyBand) {
+        BoardChunk* chunk = chunks[chunkIndex(cx, cy)].get();
+        chunk->dirtyCount = 0;
+        if (diff) {
+          std::memcpy(chunk->previous.get(), chunk->tiles, CHUNK_AREA);
+          chunk->previousVersion = versions[chunkIndex(cx, cy)];
+        }
+      }
+    }
+  }
+
+  allDirty = false;
+  pendingDiff = false;
+  dirtyCount = 0;
+  dirtyStats.emitted += out.size() - first;
+}
@@ -0,0 +1,107 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "palette.h"
+
+// Chunk geometry, a power of two so tile -> chunk math is shifts and masks
+const int CHUNK_SHIFT = 6;
+const int CHUNK_SIZE = 1 << CHUNK_SHIFT;  // Tiles per chunk side
+const int CHUNK_MASK = CHUNK_SIZE - 1;
+const int CHUNK_AREA = CHUNK_SIZE * CHUNK_SIZE;
+
+// Structure to represent a tile
+struct Tile {
+  int x{};
+  int y{};
+  ColorIndex color{};
+};
+
+// Counters describing how many tile writes were folded together before
+// being sent to clients
+struct DirtyStats {
+  uint64_t writes{};    // Every tile write since startup
+  uint64_t coalesced{}; // Writes to a tile that was already dirty this tick
+  uint64_t emitted{};   // Tiles actually handed to the broadcast
+};
+
+// How changed tiles are found for the broadcast
+enum class DeltaMode {
+  DirtyMask, // Every write sets a bit, the broadcast walks the bits
+  FrameDiff  // Writes are not tracked, the broadcast compares against last tick's copy
+};
+
+// One CHUNK_SIZE x CHUNK_SIZE block of the board. A chunk is only allocated
+// once something other than background is written into it.
+struct BoardChunk {
+  ColorIndex tiles[CHUNK_AREA];
+  uint64_t dirty[CHUNK_SIZE]; // One word per chunk row, one bit per tile
+  int dirtyCount;
+  std::unique_ptr<ColorIndex[]> previous; // Tiles as of the last broadcast, FrameDiff mode only
+  uint64_t previousVersion;               // Chunk version when previous was taken
+};
+
+// Grid of palette indices stored as lazily allocated chunks, one byte per
+// tile. Every write sets a bit in the chunk's dirty mask so a tick emits
+// each changed tile once, with its final color, no matter how often it was
+// repainted. Each chunk also carries a version that increases whenever any
+// of its tiles changes, so joins and persistence can work chunk by chunk.
+// In FrameDiff mode writes skip the dirty mask entirely and the broadcast
+// finds changes by comparing each touched chunk with its previous copy.
+class Board {
+public:
+  Board();
+  void setDeltaMode(DeltaMode mode); // Call before resize()
+  DeltaMode getDeltaMode() const { return deltaMode; }
+  void resize(int cols, int rows);
+  void reset();
+
+  int cols() const { return width; }
+  int rows() const { return height; }
+  bool inBounds(int x, int y) const { return x >= 0 && x < width && y >= 0 && y < height; }
+
+  ColorIndex get(int x, int y) const {
+    const BoardChunk* chunk = chunks[chunkIndex(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT)].get();
+    return chunk ? chunk->tiles[((y & CHUNK_MASK) << CHUNK_SHIFT) | (x & CHUNK_MASK)] : BACKGROUND_COLOR;
+  }
+  void set(int x, int y, ColorIndex color);
+  void copyRow(int y, ColorIndex* out) const;
+
+  // Chunk access
+  int chunkCols() const { return chunksWide; }
+  int chunkRows() const { return chunksHigh; }
+  int chunkIndex(int cx, int cy) const { return cy * chunksWide + cx; }
+  const ColorIndex* chunkTiles(int cx, int cy) const;
+  uint64_t chunkVersion(int cx, int cy) const { return versions[chunkIndex(cx, cy)]; }
+  int allocatedChunkCount() const { return allocatedChunks; }
+
+  // Dirty tracking
+  bool hasDirtyTiles() const { return dirtyCount > 0 || pendingDiff; }
+  size_t dirtyTileCount() const { return dirtyCount; }
+  bool needsFullResync() const { return allDirty; }
+  void collectDirtyTiles(std::vector<Tile>& out);
+  const DirtyStats& stats() const { return dirtyStats; }
+
+private:
+  BoardChunk* allocateChunk(int cx, int cy);
+  void collectAllTiles(std::vector<Tile>& out);
+
+  int width;
+  int height;
+  int chunksWide;
+  int chunksHigh;
+  std::vector<std::unique_ptr<BoardChunk>> chunks;
+  std::vector<uint64_t> versions; // Kept even for unallocated chunks so a reset still bumps them
+  int allocatedChunks;
+  size_t dirtyCount;
+  bool allDirty; // Set by reset(), every tile goes out on the next collect
+  DeltaMode deltaMode;
+  bool pendingDiff; // FrameDiff mode: some chunk was written since the last collect
+  std::vector<int> dirtyBand; // Scratch list of dirty chunk columns in one band
+  DirtyStats dirtyStats;
+};
+
+#endif // BOARD_H
@@ -0,0 +1,108 @@
+#include "circle_kernel.h"
+
+#include <algorithm>
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define CIRCLE_KERNEL_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define CIRCLE_KERNEL_SSE2
+#endif
+
+static const int MAX_DELTA = 32767;
+
+static bool scalarHit(int x, int y, int reach, const int* xs, const int* ys, const int* radii, int i)
+{
+  int dx = std::min(std::max(xs[i] - x, -MAX_DELTA), MAX_DELTA);
+  int dy = std::min(std::max(ys[i] - y, -MAX_DELTA), MAX_DELTA);
+  int limit = reach + (radii ? radii[i] : 0);
+  return dx * dx + dy * dy <= limit * limit;
+}
+
+#if defined(CIRCLE_KERNEL_SSE2)
+// SSE2 has no 32-bit min, max or low multiply, these stand in for them
+static __m128i clamp32(__m128i value, __m128i lower, __m128i upper)
+{
+  __m128i above = _mm_cmpgt_epi32(value, upper);
+  value = _mm_or_si128(_mm_and_si128(above, upper), _mm_andnot_si128(above, value));
+  __m128i below = _mm_cmplt_epi32(value, lower);
+  return _mm_or_si128(_mm_and_si128(below, lower), _mm_andnot_si128(below, value));
+}
+
+static __m128i mullo32(__m128i a, __m128i b)
+{
+  __m128i even = _mm_mul_epu32(a, b);
+  __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+#endif
+
+void circleHitMask(int x, int y, int reach, const int* xs, const int* ys, const int* radii, int count, uint64_t* hits)
+{
+  std::fill(hits, hits + ((count + 63) >> 6), 0);
+  int i = 0;
+
+#if defined(CIRCLE_KERNEL_AVX2)
+  const __m256i queryX = _mm256_set1_epi32(x);
+  const __m256i queryY = _mm256_set1_epi32(y);
+  const __m256i queryReach = _mm256_set1_epi32(reach);
+  const __m256i upper = _mm256_set1_epi32(MAX_DELTA);
+  const __m256i lower = _mm256_set1_epi32(-MAX_DELTA);
+  for (; i + 8 <= count; i += 8) {
+    __m256i dx = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(xs + i)), queryX);
+    __m256i dy = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ys + i)), queryY);
+    dx = _mm256_min_epi32(_mm256_max_epi32(dx, lower), upper);
+    dy = _mm256_min_epi32(_mm256_max_epi32(dy, lower), upper);
+    __m256i distance = _mm256_add_epi32(_mm256_mullo_epi32(dx, dx), _mm256_mullo_epi32(dy, dy));
+    __m256i limit = queryReach;
+    if (radii) limit = _mm256_add_epi32(limit, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(radii + i)));
+    limit = _mm256_mullo_epi32(limit, limit);
+    // Lanes where distance > limit miss
+    __m256i miss = _mm256_cmpgt_epi32(distance, limit);
+    uint64_t bits = ~static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(miss))) & 0xFF;
+    hits[i >> 6] |= bits << (i & 63);
+  }
+#elif defined(CIRCLE_KERNEL_SSE2)
+  const __m128i queryX = _mm_set1_epi32(x);
+  const __m128i queryY = _mm_set1_epi32(y);
+  const __m128i queryReach = _mm_set1_epi32(reach);
+  const __m128i upper = _mm_set1_epi32(MAX_DELTA);
+  const __m128i lower = _mm_set1_epi32(-MAX_DELTA);
+  const __m128i lowHalf = _mm_set1_epi32(0xFFFF);
+  for (; i + 4 <= count; i += 4) {
+    __m128i dx = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(xs + i)), queryX);
+    __m128i dy = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ys + i)), queryY);
+    dx = clamp32(dx, lower, upper);
+    dy = clamp32(dy, lower, upper);
+    // Clamped deltas fit in 16 bits, so one multiply-add of (dx, dy) pairs
+    // gives dx^2 + dy^2 per lane
+    __m128i pairs = _mm_or_si128(_mm_and_si128(dx, lowHalf), _mm_slli_epi32(dy, 16));
+    __m128i distance = _mm_madd_epi16(pairs, pairs);
+    __m128i limit = queryReach;
+    if (radii) limit = _mm_add_epi32(limit, _mm_loadu_si128(reinterpret_cast<const __m128i*>(radii + i)));
+    limit = mullo32(limit, limit);
+    // Lanes where distance > limit miss
+    __m128i miss = _mm_cmpgt_epi32(distance, limit);
+    uint64_t bits = ~static_cast<uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(miss))) & 0xF;
+    hits[i >> 6] |= bits << (i & 63);
+  }
+#endif
+
+  for (; i < count; i++) {
+    if (scalarHit(x, y, reach, xs, ys, radii, i)) {
+      hits[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+  }
+}
+
+const char* circleKernelName()
+{
+#if defined(CIRCLE_KERNEL_AVX2)
+  return "AVX2";
+#elif defined(CIRCLE_KERNEL_SSE2)
+  return "SSE2";
+#else
+  return "scalar";
+#endif
+}
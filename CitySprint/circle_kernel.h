@@ -0,0 +1,18 @@
+#ifndef CIRCLE_KERNEL_H
+#define CIRCLE_KERNEL_H
+
+#include <cstdint>
+
+// Narrow phase for one query point against a batch of circles stored as
+// separate x, y and radius arrays. Sets bit i of hits (bit i % 64 of word
+// i / 64) where dx^2 + dy^2 <= (reach + radii[i])^2, and clears the rest.
+// radii may be null to test centers only. Works in 32-bit integer lanes:
+// deltas are clamped to +-32767 so the squares cannot overflow, which is
+// exact for any reach below that. Uses AVX2 when the build enables it,
+// SSE2 on any x86-64 target, and a scalar loop elsewhere.
+void circleHitMask(int x, int y, int reach, const int* xs, const int* ys, const int* radii, int count, uint64_t* hits);
+
+// Name of the kernel compiled in, for the startup log
+const char* circleKernelName();
+
+#endif // CIRCLE_KERNEL_H
@@ -0,0 +1,46 @@
+#include "client_outbox.h"
+
+#include <utility>
+
+ClientOutbox::ClientOutbox(size_t byteLimit) : queuedBytes(0), byteLimit(byteLimit), closed(false) {}
+
+// A frame bigger than the limit is still accepted into an empty outbox, a
+// text keyframe of a large map can be several megabytes on its own
+bool ClientOutbox::push(std::shared_ptr<const std::string> frame) {
+  bool overflowed = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (closed) return true;
+    overflowed = !frames.empty() && queuedBytes + frame->size() > byteLimit;
+    if (overflowed) {
+      closed = true;
+      frames.clear();
+      queuedBytes = 0;
+    } else {
+      queuedBytes += frame->size();
+      frames.push_back(std::move(frame));
+    }
+  }
+  ready.notify_one();
+  return !overflowed;
+}
+
+std::shared_ptr<const std::string> ClientOutbox::pop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  ready.wait(lock, [this] { return closed || !frames.empty(); });
+  if (closed) return nullptr;
+  std::shared_ptr<const std::string> frame = std::move(frames.front());
+  frames.pop_front();
+  queuedBytes -= frame->size();
+  return frame;
+}
+
+void ClientOutbox::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    frames.clear();
+    queuedBytes = 0;
+  }
+  ready.notify_all();
+}
@@ -0,0 +1,38 @@
+#ifndef CLIENT_OUTBOX_H
+#define CLIENT_OUTBOX_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Frames waiting to go out to one client. The simulation thread queues them
+// and moves on; the client's sender thread takes them off and does the
+// blocking send, so a slow connection only ever holds up itself. Frames are
+// shared, a broadcast is encoded once however many clients get it.
+class ClientOutbox {
+public:
+  explicit ClientOutbox(size_t byteLimit);
+  ClientOutbox(const ClientOutbox&) = delete;
+  ClientOutbox& operator=(const ClientOutbox&) = delete;
+
+  // Simulation thread. Dropped once the outbox is closed. False when the
+  // client has fallen more than byteLimit behind, which closes the outbox.
+  bool push(std::shared_ptr<const std::string> frame);
+  // Sender thread. Waits for the next frame, nullptr once closed.
+  std::shared_ptr<const std::string> pop();
+  // Any thread. Drops whatever is still queued and wakes the sender.
+  void close();
+
+private:
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<std::shared_ptr<const std::string>> frames;
+  size_t queuedBytes;
+  size_t byteLimit;
+  bool closed;
+};
+
+#endif // CLIENT_OUTBOX_H
@@ -0,0 +1,30 @@
+#include "command_queue.h"
+
+#include <utility>
+
+// The list always holds one consumed node, so producers never see it empty
+CommandQueue::CommandQueue() : newest(new Node()), oldest(newest.load(std::memory_order_relaxed)) {}
+
+CommandQueue::~CommandQueue() {
+  while (oldest) {
+    Node* next = oldest->next.load(std::memory_order_relaxed);
+    delete oldest;
+    oldest = next;
+  }
+}
+
+void CommandQueue::push(Command command) {
+  Node* node = new Node();
+  node->command = std::move(command);
+  Node* previous = newest.exchange(node, std::memory_order_acq_rel);
+  previous->next.store(node, std::memory_order_release);
+}
+
+bool CommandQueue::pop(Command& command) {
+  Node* next = oldest->next.load(std::memory_order_acquire);
+  if (!next) return false;
+  command = std::move(next->command);
+  delete oldest;
+  oldest = next;
+  return true;
+}
@@ -0,0 +1,55 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class ClientOutbox;
+
+// What a network thread asks the simulation to do
+enum class CommandType : uint8_t {
+  Join,    // A client finished its handshake
+  Message, // A client sent a message
+  Leave    // A client disconnected
+};
+
+struct Command {
+  CommandType type{};
+  uint64_t client{}; // The client's socket, widened so it fits on every platform
+  bool binary{};     // Join, the client negotiated the binary board protocol
+  std::string text;  // Message, the decoded message
+  std::shared_ptr<ClientOutbox> outbox; // Join, where frames for the client are queued
+};
+
+// Lock-free queue of commands from any number of network threads to the
+// simulation thread, which is the only one that touches the game state.
+// Commands are linked into a list: a push swaps its node in as the newest
+// with one atomic exchange and then links the previous newest to it, so
+// pushing never waits on anyone. The consumer follows the links from the
+// oldest node. A push caught between its two steps hides everything after
+// it until it finishes, which only delays those commands to the next pop.
+class CommandQueue {
+public:
+  CommandQueue();
+  ~CommandQueue();
+  CommandQueue(const CommandQueue&) = delete;
+  CommandQueue& operator=(const CommandQueue&) = delete;
+
+  // Any thread
+  void push(Command command);
+  // Simulation thread only. False when nothing is ready.
+  bool pop(Command& command);
+
+private:
+  struct Node {
+    std::atomic<Node*> next{ nullptr };
+    Command command;
+  };
+
+  std::atomic<Node*> newest; // Producers swap their node in here
+  Node* oldest;              // Already consumed, its successor is the next command
+};
+
+#endif // COMMAND_QUEUE_H
@@ -0,0 +1,337 @@
+#include "entity_store.h"
+#include "raster.h"
+#include "circle_kernel.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef _MSC_VER
+  #include <intrin.h>
+#endif
+
+// Index of the lowest set bit, word must be non-zero
+static int lowestSetBit(uint64_t word)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, word);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(word);
+#endif
+}
+
+EntityFilter anyEntity()
+{
+  return EntityFilter();
+}
+
+EntityFilter ofType(EntityType type)
+{
+  EntityFilter filter;
+  filter.typeMask = static_cast<uint8_t>(1 << static_cast<int>(type));
+  return filter;
+}
+
+EntityFilter ownedBy(EntityOwner owner, EntityType type)
+{
+  EntityFilter filter = ofType(type);
+  filter.ownerMatch = EntityFilter::Owner::Only;
+  filter.owner = owner;
+  return filter;
+}
+
+EntityFilter notOwnedBy(EntityOwner owner)
+{
+  EntityFilter filter;
+  filter.ownerMatch = EntityFilter::Owner::Except;
+  filter.owner = owner;
+  return filter;
+}
+
+EntityStore::EntityStore(std::pmr::memory_resource* resource, uint32_t firstGeneration) :
+  ids(resource), types(resource), owners(resource), xs(resource), ys(resource), radii(resource), attacks(resource), defenses(resource), colors(resource),
+  colliding(resource), targets(resource), targetCells(resource), targetSearches(resource), moving(resource), orderXs(resource), orderYs(resource), moveProgress(resource), waitTicks(resource), attackProgress(resource), kinds(resource), slots(resource), freeSlots(resource), denseSlots(resource),
+  handlesById(resource), firstGeneration(firstGeneration), grid(resource), occupancy(resource) {}
+
+EntityHandle EntityStore::create(EntityType type, EntityOwner owner, int id, int x, int y, const EntityStats& kind) {
+  uint32_t slot;
+  if (!freeSlots.empty()) {
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+  } else {
+    slot = static_cast<uint32_t>(slots.size());
+    slots.push_back({ 0, firstGeneration });
+  }
+  slots[slot].dense = static_cast<uint32_t>(ids.size());
+
+  ids.push_back(id);
+  types.push_back(type);
+  owners.push_back(owner);
+  xs.push_back(x);
+  ys.push_back(y);
+  radii.push_back(kind.size);
+  attacks.push_back(kind.attack);
+  defenses.push_back(kind.defense);
+  colors.push_back(colorIndex(kind.color));
+  colliding.push_back(0);
+  targets.push_back(EntityHandle());
+  targetCells.push_back(-1);
+  targetSearches.push_back(0);
+  moving.push_back(MoveState::Idle);
+  orderXs.push_back(x);
+  orderYs.push_back(y);
+  moveProgress.push_back(0);
+  waitTicks.push_back(0);
+  attackProgress.push_back(0);
+  kinds.push_back(&kind);
+  denseSlots.push_back(slot);
+
+  EntityHandle handle = { slot, slots[slot].generation };
+  handlesById[id] = handle;
+  grid.insert(slot, x, y, kind.size);
+  occupancy.stamp(x, y, kind.size);
+  return handle;
+}
+
+// Moves the last entity into the freed index so the columns stay packed
+bool EntityStore::destroy(EntityHandle handle) {
+  int index = indexOf(handle);
+  if (index < 0) return false;
+
+  int last = size() - 1;
+  handlesById.erase(ids[index]);
+  grid.remove(handle.slot, xs[index], ys[index]);
+  occupancy.unstamp(xs[index], ys[index], radii[index]);
+  if (index != last) {
+    ids[index] = ids[last];
+    types[index] = types[last];
+    owners[index] = owners[last];
+    xs[index] = xs[last];
+    ys[index] = ys[last];
+    radii[index] = radii[last];
+    attacks[index] = attacks[last];
+    defenses[index] = defenses[last];
+    colors[index] = colors[last];
+    colliding[index] = colliding[last];
+    targets[index] = targets[last];
+    targetCells[index] = targetCells[last];
+    targetSearches[index] = targetSearches[last];
+    moving[index] = moving[last];
+    orderXs[index] = orderXs[last];
+    orderYs[index] = orderYs[last];
+    moveProgress[index] = moveProgress[last];
+    waitTicks[index] = waitTicks[last];
+    attackProgress[index] = attackProgress[last];
+    kinds[index] = kinds[last];
+    denseSlots[index] = denseSlots[last];
+    slots[denseSlots[index]].dense = static_cast<uint32_t>(index);
+  }
+  ids.pop_back();
+  types.pop_back();
+  owners.pop_back();
+  xs.pop_back();
+  ys.pop_back();
+  radii.pop_back();
+  attacks.pop_back();
+  defenses.pop_back();
+  colors.pop_back();
+  colliding.pop_back();
+  targets.pop_back();
+  targetCells.pop_back();
+  targetSearches.pop_back();
+  moving.pop_back();
+  orderXs.pop_back();
+  orderYs.pop_back();
+  moveProgress.pop_back();
+  waitTicks.pop_back();
+  attackProgress.pop_back();
+  kinds.pop_back();
+  denseSlots.pop_back();
+
+  slots[handle.slot].generation++;
+  freeSlots.push_back(handle.slot);
+  return true;
+}
+
+void EntityStore::clear() {
+  while (size() > 0) {
+    destroy(handleAt(size() - 1));
+  }
+}
+
+bool EntityStore::move(EntityHandle handle, int x, int y) {
+  int index = indexOf(handle);
+  if (index < 0) return false;
+  grid.move(handle.slot, xs[index], ys[index], x, y);
+  occupancy.unstamp(xs[index], ys[index], radii[index]);
+  occupancy.stamp(x, y, radii[index]);
+  xs[index] = x;
+  ys[index] = y;
+  return true;
+}
+
+void EntityStore::resizeGrid(int cols, int rows, int cellSize) {
+  grid.resize(cols, rows, cellSize);
+  occupancy.resize(cols, rows);
+  std::fill(targetCells.begin(), targetCells.end(), -1); // Cell numbers change with the grid
+  for (int i = 0; i < size(); i++) {
+    grid.insert(denseSlots[i], xs[i], ys[i], radii[i]);
+    occupancy.stamp(xs[i], ys[i], radii[i]);
+  }
+}
+
+// Two entities collide when their filled circle stamps share a tile
+int EntityStore::findOverlap(int x, int y, int radius, int ignoreId) const {
+  int ignoreX = 0;
+  int ignoreY = 0;
+  int ignoreRadius = -1;
+  int ignored = indexOf(find(ignoreId));
+  if (ignored >= 0) {
+    ignoreX = xs[ignored];
+    ignoreY = ys[ignored];
+    ignoreRadius = radii[ignored];
+  }
+
+  int hitX;
+  int hitY;
+  if (!occupancy.overlaps(x, y, radius, ignoreX, ignoreY, ignoreRadius, hitX, hitY)) return -1;
+  return entityAt(hitX, hitY, ignoreId);
+}
+
+// Footprints are Bresenham circles, which can reach half a tile past the
+// radius, so two of them can only share a tile once their midpoints are
+// within the sum of the radii plus one
+int EntityStore::sweep(int x, int y, int radius, int stepX, int stepY, int steps, int ignoreId, int& hit) const {
+  hit = -1;
+  if (steps <= 0) return 0;
+
+  int endX = x + stepX * steps;
+  int endY = y + stepY * steps;
+  int halfLength = (std::abs(endX - x) + std::abs(endY - y)) / 2 + 1;
+  int64_t vx = stepX;
+  int64_t vy = stepY;
+  int64_t speed = vx * vx + vy * vy;
+  int first = steps + 1; // Earliest step that could touch something
+  grid.forEachCellNear((x + endX) / 2, (y + endY) / 2, halfLength + radius + grid.largestRadius() + 1, [&](const GridCell& cell) {
+    for (int i = 0; i < cell.size(); i++) {
+      if (ids[slots[cell.slots[i]].dense] == ignoreId) continue;
+      int64_t contact = radius + cell.radii[i] + 1;
+      int64_t px = x - cell.xs[i];
+      int64_t py = y - cell.ys[i];
+      // Solve |p + k * v|^2 = contact^2 for the first k
+      int64_t along = px * vx + py * vy;
+      int64_t gap = px * px + py * py - contact * contact;
+      if (gap <= 0) {
+        first = 1; // Already close, check every step
+        continue;
+      }
+      if (along >= 0) continue; // Moving away
+      int64_t discriminant = along * along - speed * gap;
+      if (discriminant < 0) continue; // Passes by
+      double root = (-along - std::sqrt(static_cast<double>(discriminant))) / speed;
+      first = std::min(first, std::max(1, static_cast<int>(std::floor(root))));
+    }
+    return first > 1;
+  });
+
+  for (int k = first; k <= steps; k++) {
+    hit = findOverlap(x + stepX * k, y + stepY * k, radius, ignoreId);
+    if (hit >= 0) return k - 1;
+  }
+  return steps;
+}
+
+int EntityStore::entityAt(int x, int y, int ignoreId) const {
+  int found = -1;
+  grid.forEachNear(x, y, grid.largestRadius(), [&](uint32_t slot) {
+    int index = static_cast<int>(slots[slot].dense);
+    int dy = y - ys[index];
+    if (ids[index] == ignoreId || dy < -radii[index] || dy > radii[index]) return true;
+    const Span& span = circleStamp(radii[index]).filled[dy + radii[index]];
+    if (x >= xs[index] + span.x0 && x <= xs[index] + span.x1) {
+      found = index;
+      return false;
+    }
+    return true;
+  });
+  return found;
+}
+
+// Candidates are tested a whole cell at a time by the circle kernel, the
+// filter only runs on hits
+void EntityStore::queryRadius(int x, int y, int radius, const EntityFilter& filter, HandleList& out, bool reachEdges) const {
+  const int BATCH = 256;
+  uint64_t hits[BATCH / 64];
+  int reach = reachEdges ? radius + grid.largestRadius() : radius;
+  grid.forEachCellNear(x, y, reach, [&](const GridCell& cell) {
+    for (int first = 0; first < cell.size(); first += BATCH) {
+      int count = std::min(BATCH, cell.size() - first);
+      const int* cellRadii = reachEdges ? cell.radii.data() + first : nullptr;
+      circleHitMask(x, y, radius, cell.xs.data() + first, cell.ys.data() + first, cellRadii, count, hits);
+      for (int word = 0; word < (count + 63) / 64; word++) {
+        for (uint64_t bits = hits[word]; bits; bits &= bits - 1) {
+          uint32_t slot = cell.slots[first + word * 64 + lowestSetBit(bits)];
+          int index = static_cast<int>(slots[slot].dense);
+          if (filter.accepts(types[index], owners[index])) {
+            out.push_back({ slot, slots[slot].generation });
+          }
+        }
+      }
+    }
+    return true;
+  });
+}
+
+// Anything within reach of (x, y) lies in the cells forEachNear visits, so
+// once k candidates are within reach they are the k nearest overall
+void EntityStore::nearest(int x, int y, int k, const EntityFilter& filter, HandleList& out) const {
+  if (k <= 0) return;
+  std::vector<std::pair<int64_t, uint32_t>> candidates;
+  int fullReach = grid.fullReach(x, y);
+  for (int reach = std::max(grid.largestRadius(), 1);; reach *= 2) {
+    bool everything = reach >= fullReach;
+    int64_t limit = static_cast<int64_t>(reach) * reach;
+    candidates.clear();
+    int withinReach = 0;
+    grid.forEachNear(x, y, reach, [&](uint32_t slot) {
+      int index = static_cast<int>(slots[slot].dense);
+      if (!filter.accepts(types[index], owners[index])) return true;
+      int64_t dx = xs[index] - x;
+      int64_t dy = ys[index] - y;
+      int64_t distance = dx * dx + dy * dy;
+      if (distance <= limit) withinReach++;
+      candidates.push_back({ distance, slot });
+      return true;
+    });
+    if (withinReach >= k || everything) break;
+  }
+
+  // Ties go to the lower slot so repeated queries agree
+  size_t count = std::min(candidates.size(), static_cast<size_t>(k));
+  std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+  for (size_t i = 0; i < count; i++) {
+    uint32_t slot = candidates[i].second;
+    out.push_back({ slot, slots[slot].generation });
+  }
+}
+
+int EntityStore::indexOf(EntityHandle handle) const {
+  if (handle.slot >= slots.size()) return -1;
+  const Slot& slot = slots[handle.slot];
+  if (slot.generation != handle.generation || slot.dense >= denseSlots.size() || denseSlots[slot.dense] != handle.slot) return -1;
+  return static_cast<int>(slot.dense);
+}
+
+uint32_t EntityStore::unusedGeneration() const {
+  uint32_t generation = firstGeneration;
+  for (const Slot& slot : slots) {
+    generation = std::max(generation, slot.generation + 1);
+  }
+  return generation;
+}
+
+EntityHandle EntityStore::find(int id) const {
+  auto it = handlesById.find(id);
+  return it == handlesById.end() ? EntityHandle() : it->second;
+}
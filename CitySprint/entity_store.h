@@ -0,0 +1,192 @@
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "palette.h"
+#include "occupancy.h"
+#include "spatial_grid.h"
+
+enum class EntityType : uint8_t {
+  City,
+  Troop,
+  Building
+};
+
+// Stats every entity of one kind starts with. The live values are copied
+// into the EntityStore when an entity is created.
+struct EntityStats {
+  int size{};
+  int defense{};
+  int attack{};
+  std::string color;
+};
+
+struct Troop : public EntityStats {
+  int movement{};
+  int attackDistance{};
+  int cost{};
+  int foodCost{};
+};
+
+struct Building : public EntityStats {
+  int cost{};
+  int food{};
+  int coins{};
+};
+
+// Where a unit is in carrying out its move order
+enum class MoveState : uint8_t {
+  Idle,    // No order
+  Pathing, // Waiting for its route to be found
+  Walking
+};
+
+// Owning player, the player's socket widened so it fits on every platform
+typedef uint64_t EntityOwner;
+
+// Which entities a spatial query may return
+struct EntityFilter {
+  enum class Owner : uint8_t {
+    Any,
+    Only,  // Owned by owner
+    Except // Owned by anyone but owner
+  };
+
+  uint8_t typeMask = 0xFF; // Bit per EntityType
+  Owner ownerMatch = Owner::Any;
+  EntityOwner owner = 0;
+
+  bool accepts(EntityType type, EntityOwner entityOwner) const {
+    if (!(typeMask & (1 << static_cast<int>(type)))) return false;
+    if (ownerMatch == Owner::Only) return entityOwner == owner;
+    if (ownerMatch == Owner::Except) return entityOwner != owner;
+    return true;
+  }
+};
+
+EntityFilter anyEntity();
+EntityFilter ofType(EntityType type);
+EntityFilter ownedBy(EntityOwner owner, EntityType type);
+EntityFilter notOwnedBy(EntityOwner owner);
+
+// Refers to one entity for as long as it lives. The slot's generation is
+// bumped whenever the entity is destroyed, so a handle kept past that point
+// stops resolving instead of pointing at whatever reuses the slot.
+struct EntityHandle {
+  uint32_t slot = UINT32_MAX;
+  uint32_t generation = 0;
+
+  bool operator==(const EntityHandle& other) const { return slot == other.slot && generation == other.generation; }
+  bool operator!=(const EntityHandle& other) const { return !(*this == other); }
+};
+
+// Handles returned by the spatial queries
+typedef std::pmr::vector<EntityHandle> HandleList;
+
+// Every live entity in the match, stored as parallel arrays so passes over
+// positions or health touch only the columns they need. Index i describes
+// the same entity in every column. Destroying an entity moves the last one
+// into its place, so indices only hold until the next destroy; anything
+// kept longer must be a handle. Handles and ids both resolve in O(1).
+// Positions are mirrored into a uniform grid and every entity's footprint
+// into an occupancy bitmap, so moves go through move().
+// Every column, the grid and the bitmap take their memory from the
+// resource given at construction, so a match can hand all of it back at
+// once. New slots start at firstGeneration, which lets a store replacing
+// an old one keep the old store's handles from resolving.
+// Not synchronized, only the simulation thread touches it.
+class EntityStore {
+public:
+  explicit EntityStore(std::pmr::memory_resource* resource = std::pmr::get_default_resource(), uint32_t firstGeneration = 0);
+
+  EntityHandle create(EntityType type, EntityOwner owner, int id, int x, int y, const EntityStats& kind);
+  bool destroy(EntityHandle handle);
+  void clear();
+  bool move(EntityHandle handle, int x, int y);
+
+  // Rebuilds the grid (with the given cell size) and the occupancy bitmap
+  // over cols x rows
+  void resizeGrid(int cols, int rows, int cellSize);
+
+  // Index of an entity whose footprint shares a tile with a circle of the
+  // given radius at (x, y), ignoring the entity with ignoreId, or -1. The
+  // test runs against the occupancy bitmap; entities are only looked up on
+  // a hit, through the grid cells around the conflicting tile.
+  int findOverlap(int x, int y, int radius, int ignoreId) const;
+
+  // Number of steps of (stepX, stepY), at most steps, a circle starting
+  // at (x, y) can take before its footprint overlaps another entity. The
+  // capsule swept along the path is tested against the nearby circles
+  // first, so footprints are only compared from the earliest step that
+  // could touch something. The index of the blocking entity, or -1, is
+  // written to hit.
+  int sweep(int x, int y, int radius, int stepX, int stepY, int steps, int ignoreId, int& hit) const;
+
+  // Index of an entity whose footprint covers the tile, or -1
+  int entityAt(int x, int y, int ignoreId) const;
+
+  // Appends every accepted entity whose midpoint lies within radius of
+  // (x, y). With reachEdges the entity's own radius is added, so anything
+  // whose circle comes that close is returned.
+  void queryRadius(int x, int y, int radius, const EntityFilter& filter, HandleList& out, bool reachEdges = false) const;
+  // Grid change count when the last entity was created, destroyed or moved
+  // anywhere a queryRadius with reachEdges at (x, y) would look
+  uint64_t changedNear(int x, int y, int radius) const { return grid.changedNear(x, y, radius + grid.largestRadius()); }
+  uint64_t gridVersion() const { return grid.version(); }
+
+  // Appends up to k accepted entities closest to (x, y), nearest first.
+  // The search widens ring by ring through the grid until it has k.
+  void nearest(int x, int y, int k, const EntityFilter& filter, HandleList& out) const;
+
+  bool isAlive(EntityHandle handle) const { return indexOf(handle) >= 0; }
+  int indexOf(EntityHandle handle) const; // -1 once the entity is gone
+  EntityHandle find(int id) const;
+  EntityHandle handleAt(int index) const { return { denseSlots[index], slots[denseSlots[index]].generation }; }
+  int size() const { return static_cast<int>(ids.size()); }
+  int cellOf(int index) const { return grid.cellIndex(xs[index], ys[index]); }
+  // A generation no handle from this store has ever carried
+  uint32_t unusedGeneration() const;
+
+  // Columns
+  std::pmr::vector<int> ids;
+  std::pmr::vector<EntityType> types;
+  std::pmr::vector<EntityOwner> owners;
+  std::pmr::vector<int> xs;
+  std::pmr::vector<int> ys;
+  std::pmr::vector<int> radii;
+  std::pmr::vector<int> attacks;
+  std::pmr::vector<int> defenses;
+  std::pmr::vector<ColorIndex> colors;
+  std::pmr::vector<uint8_t> colliding; // Took part in a fight since the last clear
+  std::pmr::vector<EntityHandle> targets; // Enemy a troop is attacking, empty handle if none
+  std::pmr::vector<int> targetCells; // Grid cell the troop was in when it picked its target, -1 to pick again
+  std::pmr::vector<uint64_t> targetSearches; // Grid version when the troop last looked for a target
+  std::pmr::vector<MoveState> moving;
+  std::pmr::vector<int> orderXs; // Where a move order is headed
+  std::pmr::vector<int> orderYs;
+  std::pmr::vector<int> moveProgress; // Movement earned toward the next tile, in ticks per second units
+  std::pmr::vector<int> waitTicks; // Ticks a walking troop has spent stuck behind a friendly troop
+  std::pmr::vector<int> attackProgress; // Time in combat toward the next strike, in ticks per second units
+  std::pmr::vector<const EntityStats*> kinds; // Troop or Building stats, by type
+
+private:
+  struct Slot {
+    uint32_t dense;
+    uint32_t generation;
+  };
+
+  std::pmr::vector<Slot> slots;
+  std::pmr::vector<uint32_t> freeSlots;
+  std::pmr::vector<uint32_t> denseSlots; // Column index -> slot
+  std::pmr::unordered_map<int, EntityHandle> handlesById;
+  uint32_t firstGeneration;
+  SpatialGrid grid;
+  OccupancyMap occupancy;
+};
+
+#endif // ENTITY_STORE_H
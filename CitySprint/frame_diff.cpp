@@ -0,0 +1,54 @@
+#include "frame_diff.h"
+#include "board.h"
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define FRAME_DIFF_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define FRAME_DIFF_SSE2
+#endif
+
+static_assert(CHUNK_SIZE == 64, "diffChunkRow produces one 64-bit mask per chunk row");
+
+uint64_t diffChunkRow(const ColorIndex* current, const ColorIndex* previous)
+{
+#if defined(FRAME_DIFF_AVX2)
+  uint64_t equal = 0;
+  for (int i = 0; i < 2; i++) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current + i * 32));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous + i * 32));
+    uint32_t bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+    equal |= static_cast<uint64_t>(bits) << (i * 32);
+  }
+  return ~equal;
+#elif defined(FRAME_DIFF_SSE2)
+  uint64_t equal = 0;
+  for (int i = 0; i < 4; i++) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current + i * 16));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i * 16));
+    uint32_t bits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+    equal |= static_cast<uint64_t>(bits) << (i * 16);
+  }
+  return ~equal;
+#else
+  uint64_t changed = 0;
+  for (int i = 0; i < CHUNK_SIZE; i++) {
+    if (current[i] != previous[i]) {
+      changed |= uint64_t(1) << i;
+    }
+  }
+  return changed;
+#endif
+}
+
+const char* frameDiffKernelName()
+{
+#if defined(FRAME_DIFF_AVX2)
+  return "AVX2";
+#elif defined(FRAME_DIFF_SSE2)
+  return "SSE2";
+#else
+  return "scalar";
+#endif
+}
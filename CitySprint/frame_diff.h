@@ -0,0 +1,16 @@
+#ifndef FRAME_DIFF_H
+#define FRAME_DIFF_H
+
+#include <cstdint>
+
+#include "palette.h"
+
+// Compares one 64-tile chunk row against its copy from the previous tick
+// and returns a mask with bit i set where tile i differs. Uses AVX2 when the
+// build enables it, SSE2 on any x86-64 target, and a scalar loop elsewhere.
+uint64_t diffChunkRow(const ColorIndex* current, const ColorIndex* previous);
+
+// Name of the kernel compiled in, for the startup log
+const char* frameDiffKernelName();
+
+#endif // FRAME_DIFF_H
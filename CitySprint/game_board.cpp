@@ -0,0 +1,24 @@
+#include "game_board.h"
+
+template class GameBoard<750, 300, 2>;
+template class GameBoard<1500, 600, 2>;
+template class GameBoard<3000, 1200, 2>;
+
+static const MapGeometry SHIPPED_MAPS[] = {
+  SmallMap::geometry("small"),
+  StandardMap::geometry("standard"),
+  LargeMap::geometry("large")
+};
+
+const MapGeometry* findMap(const std::string& name)
+{
+  for (const MapGeometry& map : SHIPPED_MAPS) {
+    if (name == map.name) return &map;
+  }
+  return nullptr;
+}
+
+MapGeometry customMap(int pixelWidth, int pixelHeight, int tileSize)
+{
+  return { "custom", pixelWidth, pixelHeight, tileSize, pixelWidth / tileSize, pixelHeight / tileSize };
+}
@@ -0,0 +1,83 @@
+#ifndef GAME_BOARD_H
+#define GAME_BOARD_H
+
+#include <string>
+
+#include "board.h"
+
+// Runtime description of a map, used wherever the size is picked at startup
+struct MapGeometry {
+  const char* name;
+  int pixelWidth;
+  int pixelHeight;
+  int tileSize;
+  int cols;
+  int rows;
+};
+
+// Geometry of one map size, fixed at compile time. The sizes are checked
+// when the map is declared and everything derived from them is constexpr,
+// so board code instantiated for a shipped map folds its bounds checks and
+// chunk stride into immediates. RuntimeBoard has the same interface for
+// sizes only known at startup.
+template <int Width, int Height, int TileSize>
+class GameBoard {
+public:
+  static_assert(TileSize > 0 && (TileSize & (TileSize - 1)) == 0, "Tile size must be a power of two");
+  static_assert(Width % TileSize == 0 && Height % TileSize == 0, "Map size must be a whole number of tiles");
+
+  static constexpr int PIXEL_WIDTH = Width;
+  static constexpr int PIXEL_HEIGHT = Height;
+  static constexpr int TILE_SIZE = TileSize;
+  static constexpr int COLS = Width / TileSize;
+  static constexpr int ROWS = Height / TileSize;
+  static constexpr int CHUNK_COLS = (COLS + CHUNK_MASK) >> CHUNK_SHIFT;
+
+  static constexpr int cols() { return COLS; }
+  static constexpr int rows() { return ROWS; }
+  // A single unsigned compare per axis also rejects negative coordinates
+  static constexpr bool inBounds(int x, int y) {
+    return static_cast<unsigned>(x) < static_cast<unsigned>(COLS) && static_cast<unsigned>(y) < static_cast<unsigned>(ROWS);
+  }
+  static constexpr int chunkIndex(int cx, int cy) { return cy * CHUNK_COLS + cx; }
+  static constexpr bool matches(int cols, int rows) { return cols == COLS && rows == ROWS; }
+
+  static MapGeometry geometry(const char* name) {
+    return { name, PIXEL_WIDTH, PIXEL_HEIGHT, TILE_SIZE, COLS, ROWS };
+  }
+};
+
+// GameBoard's addressing for a board sized at runtime
+class RuntimeBoard {
+public:
+  RuntimeBoard(int cols, int rows) : width(cols), height(rows), chunkCols((cols + CHUNK_MASK) >> CHUNK_SHIFT) {}
+
+  int cols() const { return width; }
+  int rows() const { return height; }
+  bool inBounds(int x, int y) const {
+    return static_cast<unsigned>(x) < static_cast<unsigned>(width) && static_cast<unsigned>(y) < static_cast<unsigned>(height);
+  }
+  int chunkIndex(int cx, int cy) const { return cy * chunkCols + cx; }
+
+private:
+  int width;
+  int height;
+  int chunkCols;
+};
+
+// The map sizes we ship, instantiated once in game_board.cpp
+typedef GameBoard<750, 300, 2> SmallMap;
+typedef GameBoard<1500, 600, 2> StandardMap;
+typedef GameBoard<3000, 1200, 2> LargeMap;
+
+extern template class GameBoard<750, 300, 2>;
+extern template class GameBoard<1500, 600, 2>;
+extern template class GameBoard<3000, 1200, 2>;
+
+// Looks up a shipped map by name ("small", "standard", "large")
+const MapGeometry* findMap(const std::string& name);
+
+// Geometry for a custom pixel size, rounded down to whole tiles
+MapGeometry customMap(int pixelWidth, int pixelHeight, int tileSize);
+
+#endif // GAME_BOARD_H
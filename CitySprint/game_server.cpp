@@ -5,6 +5,8 @@
   #include <windows.h>
   #pragma comment(lib, "ws2_32.lib")
   #undef max
+  #define SHUT_RDWR SD_BOTH
+  #define MSG_NOSIGNAL 0
 #else
   #include <sys/socket.h>
   #include <netinet/in.h>
@@ -29,56 +31,60 @@
 #include <fstream>
 #include <openssl/sha.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <limits>
-#include <future>
 #include <queue>
 #include <functional>
 #include <condition_variable>
+#include <cstdlib>
+#include <memory_resource>
+#include <optional>
+#include <algorithm>
 
 #include "utilities.h"
 #include "logger.h"
+#include "palette.h"
+#include "board.h"
+#include "layered_board.h"
+#include "protocol.h"
+#include "keyframe.h"
+#include "frame_diff.h"
+#include "game_board.h"
+#include "entity_store.h"
+#include "circle_kernel.h"
+#include "influence.h"
+#include "tick_scheduler.h"
+#include "pathfinding.h"
+#include "command_queue.h"
+#include "client_outbox.h"
+#include "raster.h"
 
 // Setting up our constants, function prototypes, and structures below 
 
 // Constants
-const int BOARD_WIDTH = 1500;
-const int BOARD_HEIGHT = 600;
-const int TILE_SIZE = 2;
-
-// Structure to represent a tile
-struct Tile {
-  int x{};
-  int y{};
-  std::string color;
-};
-
-struct CollidableEntity {
-  int id;
-  std::vector<int> midpoint;
-  int size;
-  int defense;
-  int attack;
-  std::vector<int> collidingEntities; // Vector to store IDs of colliding entities
-  std::string color; // Add color to CollidableEntity
-};
-
-struct Troop : public CollidableEntity {
-  int movement{};
-  int attackDistance{};
-  int cost{};
-  int foodCost{};
-};
-
-struct Building : public CollidableEntity {
-  int cost{};
-  int food{};
+typedef StandardMap DefaultMap;
+const int TILE_SIZE = DefaultMap::TILE_SIZE;
+const int CITY_SPACING = 200; // No city may be founded closer than this to another
+const int CITY_BUILD_RANGE = 100; // How far past its edge a city lets its owner build
+const int INFLUENCE_CELL_SIZE = 8; // Tiles per side of an influence raster cell
+const int STARTING_COINS = 1000; // Coins a player starts every match with
+const int MOVE_STEPS_PER_SECOND = 20; // How often a troop covers its movement in tiles
+const int MAX_WAIT_SECONDS = 2; // Longest a troop waits behind a friendly troop before its order ends
+const int STRIKES_PER_SECOND = 60; // How often an entity in combat deals its attack
+const int MAX_CATCH_UP_STEPS = 5; // Most simulation steps one late tick may run back to back
+const int TICK_REPORT_SECONDS = 10; // How often the tick stats are logged
+const int CONTACT_GAP = 3; // Footprints that block each other can stop this many tiles apart
+const int NAV_CELL_SIZE = 4; // Tiles per side of a pathfinding grid cell
+const int PATH_BUDGET_MICROS = 2000; // Longest one path search may run before it gives up
+const size_t MAX_OUTBOX_BYTES = 64 << 20; // Unsent frames a client may fall behind by before it is dropped
+
+// A city and what it owns. Positions, health and the rest live in
+// gameState.entities; handles of destroyed entities simply stop resolving.
+struct City {
+  EntityHandle handle; // Not alive until the city is founded
   int coins{};
-};
-
-struct City : public CollidableEntity {
-  int coins{};
-  std::vector<Troop> troops;
-  std::vector<Building> buildings;
+  std::vector<EntityHandle> troops;
+  std::vector<EntityHandle> buildings;
 };
 
 // Structure to represent player state
@@ -87,74 +93,52 @@ struct PlayerState {
   int phase{};
   int coins{};
   City cities[2];
-  std::shared_ptr<Troop> selectedTroop = nullptr; // Change to shared_ptr
+  EntityHandle selectedTroop;
 };
 
-// Global Game State
-struct GameState {
-  std::unordered_map<SOCKET, PlayerState> playerStates;
-  std::vector<std::vector<std::string>> board; // 2D board representing tile colors
-  std::vector<Tile> changedTiles; // List of changed tiles
-  std::mutex stateMutex;
-  std::chrono::time_point<std::chrono::steady_clock> lastUpdate; // Add this line
+// Way a troop is walking, from the path service
+struct Route {
+  std::vector<NavPoint> waypoints;
+  size_t next{}; // Waypoint the troop is headed for
+  std::shared_ptr<const FlowField> field; // Group orders follow this instead of waypoints
 };
 
-class ThreadPool {
-public:
-  ThreadPool(size_t numThreads);
-  ~ThreadPool();
-
-  void enqueue(std::function<void()> task);
-
-private:
-  std::vector<std::thread> workers;
-  std::queue<std::function<void()>> tasks;
-
-  std::mutex queueMutex;
-  std::condition_variable condition;
-  bool stop;
+// Buffers the board tick refills every tick, kept so they stop allocating
+// once they have grown to the size of the match
+struct TickScratch {
+  explicit TickScratch(std::pmr::memory_resource* resource) : contacts(resource), strikes(resource), damage(resource), candidates(resource), destroyed(resource) {}
+
+  std::pmr::vector<std::pair<int, int>> contacts; // Combat phase, attacker and target indices
+  std::pmr::vector<int> strikes; // Combat phase, attacks each entity index lands this tick
+  std::pmr::vector<int> damage; // Combat phase, damage taken per entity index
+  HandleList candidates; // Target acquisition, enemies in range of one troop
+  HandleList destroyed; // Combat phase, entities left without defense
+  std::vector<PathResult> paths; // Movement phase, searches finished since the last tick
 };
 
-ThreadPool::ThreadPool(size_t numThreads) : stop(false) 
-{
-  std::cout << "Initializing Thread Pool with: " << std::to_string(numThreads) << " Worker Threads." << std::endl;
-  for (size_t i = 0; i < numThreads; ++i) {
-    workers.emplace_back([this] {
-      for (;;) {
-        std::function<void()> task;
-
-        {
-          std::unique_lock<std::mutex> lock(this->queueMutex);
-          this->condition.wait(lock, [this] { return this->stop || !this->tasks.empty(); });
-          if (this->stop && this->tasks.empty()) return;
-          task = std::move(this->tasks.front());
-          this->tasks.pop();
-        }
-
-        task();
-      }
-    });
-  }
-}
-
-ThreadPool::~ThreadPool() 
-{
-  {
-    std::unique_lock<std::mutex> lock(queueMutex);
-    stop = true;
-  }
-  condition.notify_all();
-  for (std::thread &worker : workers) worker.join();
-}
+// Combat totals since startup, logged with the tick stats
+struct CombatStats {
+  uint64_t attacks{};   // Attacker and target pairs resolved, one per tick of contact
+  uint64_t destroyed{}; // Entities left without defense
+};
 
-void ThreadPool::enqueue(std::function<void()> task) 
-{
-  {
-    std::unique_lock<std::mutex> lock(queueMutex);
-    tasks.push(std::move(task));
-  }
-  condition.notify_one();
-}
+// Global Game State. Only the simulation thread touches it, network
+// threads hand it their work through commandQueue.
+struct GameState {
+  std::unordered_map<SOCKET, PlayerState> playerStates;
+  std::pmr::unsynchronized_pool_resource matchPool; // Memory of everything that lasts one match
+  // Every city, troop and building in the match. Both are rebuilt from the
+  // emptied pool when a new match starts, so they can be reset in place.
+  std::optional<EntityStore> entities{ std::in_place, &matchPool };
+  std::optional<TickScratch> scratch{ std::in_place, &matchPool };
+  std::unordered_map<int, Route> routes; // Walking troops by entity ID
+  InfluenceMap influence; // City spacing and building range, refreshed when a city comes or goes
+  LayeredBoard board; // Terrain, structure and unit layers composited into one palette-indexed board
+  std::vector<Tile> changedTiles; // Scratch buffer for the tiles emitted this tick
+  Keyframe binaryKeyframe{ KeyframeFormat::Binary }; // Full board for joining binary clients, kept current every tick
+  Keyframe textKeyframe{ KeyframeFormat::Text }; // Full board for joining text clients, patched when someone joins
+  std::chrono::time_point<std::chrono::steady_clock> lastUpdate; // Add this line
+};
 
 class Semaphore {
 public:
@@ -183,68 +167,82 @@ PlayerState get_player_state(GameState& game_state, SOCKET socket);
 void remove_player(GameState& game_state, SOCKET socket);
 std::string serializePlayerStateToString(const PlayerState& player);
 void sendPlayerStateDeltaToClient(const PlayerState& player);
+void queueFrame(SOCKET client, std::shared_ptr<const std::string> frame);
+void parseCommandLine(int argc, char* argv[]);
 void initializeGameState();
+void startNewMatch();
 void initializeMaps();
-std::string serializeGameStateToString();
+int largestEntityRadius();
 void sendGameStateDeltasToClients();
-void temporarilyRemoveTroopFromGameState(Troop* troop);
-void clearCollidingEntities();
-int changeGridPoint(int x, int y, const std::string color);
-int insertCharacter(std::vector<int> coords, int radius, const std::string color, int ignoreId);
-int updateEntityMidpoint(SOCKET playerSocket, const std::vector<int>& oldMidpoint, const std::vector<int>& newMidpoint);
-void applyDamageToCollidingEntities(SOCKET playerSocket, CollidableEntity* entity);
-void checkForCollidingTroops();
-int isColliding(std::vector<int> circleOne, std::vector<int> circleTwo);
-std::shared_ptr<Troop> findNearestTroop(PlayerState& player, const std::vector<int>& coords);
+int insertCharacter(std::vector<int> coords, int radius, const std::string color, BoardLayer layer, int ignoreId, StampMode mode);
+void eraseCharacter(const std::vector<int>& coords, int radius, BoardLayer layer);
+std::vector<int> midpointOf(EntityHandle handle);
+void removeEntityFromGameState(GameState& gameState, EntityHandle handle);
+void pruneDeadHandles(GameState& gameState);
+int attackReach(const EntityStore& entities, int index);
+bool inAttackRange(const EntityStore& entities, int index, int target);
+void acquireTargets();
+void resolveCombat();
+EntityHandle findNearestTroop(PlayerState& player, const std::vector<int>& coords);
+City* findNearestCity(PlayerState& player, const std::vector<int>& coords);
 bool isWithinRadius(const std::vector<int>& point, const std::vector<int>& center, int radius);
 int checkCollision(const std::vector<int>& circleOne, int ignoreId);
-bool moveCharacter(SOCKET playerSocket, CollidableEntity* entityToMove, const std::vector<int>& newCoords);
-void moveTroopToPosition(SOCKET playerSocket, std::shared_ptr<Troop> troop, const std::vector<int>& targetCoords);
+bool nextWaypoint(Route& route, NavPoint position, NavPoint goal, NavPoint& waypoint);
+void advanceMovement();
 void handlePlayerMessage(SOCKET clientSocket, const std::string& message);
-void gameLogic(SOCKET clientSocket);
-void handleWebSocketHandshake(SOCKET clientSocket, const std::string& request);
+void queueCommand(CommandType type, SOCKET clientSocket, std::string text = std::string(), bool binary = false, std::shared_ptr<ClientOutbox> outbox = nullptr);
+void applyCommands();
+void joinPlayer(SOCKET clientSocket, bool binary, std::shared_ptr<ClientOutbox> outbox);
+void leavePlayer(SOCKET clientSocket);
+void sendFrames(SOCKET clientSocket, ClientOutbox& outbox);
+void gameLogic(SOCKET clientSocket, bool binary);
+bool handleWebSocketHandshake(SOCKET clientSocket, const std::string& request);
 void acceptPlayer(SOCKET serverSocket);
 void boardLoop();
 
 // Declaring our global variables for the game
 
 GameState gameState;
-std::map<SOCKET, sockaddr_in> clients;
+
+// Map size, picked at startup with --map or overridden with --width and --height
+MapGeometry mapGeometry = DefaultMap::geometry("standard");
+DeltaMode deltaMode = DeltaMode::DirtyMask; // --delta-mode mask|diff
+int tickRate = 60; // --tick-rate <ticks per second>
+bool matchResetAllowed = false; // --match-reset on|off, whether any player's "1000,1000" message restarts the match for everyone
+std::map<SOCKET, std::shared_ptr<ClientOutbox>> clients; // Joined clients and the outboxes their frames are queued on
+std::unordered_set<SOCKET> binaryClients; // Clients that negotiated the binary board protocol
+int paletteSizeSent = 0; // Palette entries already broadcast to binary clients
+CombatStats combatStats;
 
 std::map<std::string, Troop> troopMap;
 std::map<std::string, Building> buildingMap;
+EntityStats cityStats;
 
-std::mutex clientsMutex;
 Semaphore userSemaphore(2);
 
-size_t clientMessageCount = std::thread::hardware_concurrency() / 2;
-size_t clientSubtaskCount = clientMessageCount / 2;
-size_t leftoverThreadCount = clientMessageCount / 2;
-
-ThreadPool clientMessageThreadPool(clientMessageCount);
-ThreadPool subtaskThreadPool(clientSubtaskCount);
-ThreadPool surplusThreadsForClients(leftoverThreadCount/2);
+// A quarter of the hardware threads search paths, at least one
+size_t pathWorkerCount = std::max<size_t>(std::thread::hardware_concurrency() / 4, 1);
+PathService pathService(pathWorkerCount, std::chrono::microseconds(PATH_BUDGET_MICROS));
+CommandQueue commandQueue; // Everything the network threads ask of the game, applied at the start of each tick
 
 void update_player_state(GameState& game_state, SOCKET socket, const PlayerState& state) 
 {
-  std::scoped_lock<std::mutex> lock(game_state.stateMutex);
   game_state.playerStates[socket] = state;
 }
 
 PlayerState get_player_state(GameState& game_state, SOCKET socket) 
 {
-  std::scoped_lock<std::mutex> lock(game_state.stateMutex);
   return game_state.playerStates[socket];
 }
 
 void remove_player(GameState& game_state, SOCKET socket) 
 {
-  std::scoped_lock<std::mutex> lock(game_state.stateMutex);
   game_state.playerStates.erase(socket);
 }
 
 std::string serializePlayerStateToString(const PlayerState& player) 
 {
+  const EntityStore& entities = *gameState.entities;
   std::string result;
   result += "{\"player\": {\"coins\":\"";
   result += std::to_string(player.coins);
@@ -252,11 +250,13 @@ std::string serializePlayerStateToString(const PlayerState& player)
   // Append the troops here
   for (auto& cities : player.cities) {
     result += "{\"troops\": [";
-    for (auto& troop : cities.troops) {
+    for (EntityHandle troop : cities.troops) {
+      int index = entities.indexOf(troop);
+      if (index < 0) continue; // Destroyed since the list was copied
       result += "{ \"id\": \"";
-      result += std::to_string(troop.id);
+      result += std::to_string(entities.ids[index]);
       result += "\", \"health\": \"";
-      result += std::to_string(troop.defense);
+      result += std::to_string(entities.defenses[index]);
       result += "\"},";
     }
     result += "{}";
@@ -270,46 +270,153 @@ std::string serializePlayerStateToString(const PlayerState& player)
 void sendPlayerStateDeltaToClient(const PlayerState& player) 
 {
   std::string playerState = serializePlayerStateToString(player);
-  std::string frame = encodeWebSocketFrame(playerState);
-  int result = send(player.socket, frame.c_str(), static_cast<int>(frame.size()), 0);
-  if (result == SOCKET_ERROR) {
-    log("Failed to send update to client: " + std::to_string(WSAGetLastError()));
+  queueFrame(player.socket, std::make_shared<const std::string>(encodeWebSocketFrame(playerState)));
+}
+
+// Hands a frame to the client's sender thread, the tick never waits on a socket
+void queueFrame(SOCKET client, std::shared_ptr<const std::string> frame) 
+{
+  auto found = clients.find(client);
+  if (found == clients.end()) return; // Already left
+  if (!found->second->push(std::move(frame))) {
+    log("Client " + std::to_string(client) + " fell more than " + std::to_string(MAX_OUTBOX_BYTES) + " bytes behind, disconnecting it.");
+  }
+}
+
+// Reads optional "--map <name>", "--width <pixels>" and "--height <pixels>" flags for the world size,
+// "--delta-mode mask|diff", "--tick-rate <ticks per second>" and "--match-reset on|off"
+void parseCommandLine(int argc, char* argv[]) 
+{
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    std::string text = argv[i + 1];
+    if (flag == "--delta-mode") {
+      if (text == "mask") {
+        deltaMode = DeltaMode::DirtyMask;
+      } else if (text == "diff") {
+        deltaMode = DeltaMode::FrameDiff;
+      } else {
+        log("Ignoring invalid value for " + flag + ": " + text);
+      }
+      continue;
+    }
+    if (flag == "--match-reset") {
+      if (text == "on" || text == "off") {
+        matchResetAllowed = text == "on";
+      } else {
+        log("Ignoring invalid value for " + flag + ": " + text);
+      }
+      continue;
+    }
+    if (flag == "--map") {
+      const MapGeometry* map = findMap(text);
+      if (map) {
+        mapGeometry = *map;
+      } else {
+        log("Unknown map: " + text);
+      }
+      continue;
+    }
+    int value = std::atoi(argv[i + 1]);
+    if (flag == "--tick-rate") {
+      if (value > 0 && value <= 1000) {
+        tickRate = value;
+      } else {
+        log("Ignoring invalid value for " + flag + ": " + text);
+      }
+      continue;
+    }
+    if (value < TILE_SIZE) {
+      log("Ignoring invalid value for " + flag + ": " + argv[i + 1]);
+      continue;
+    }
+    if (flag == "--width") {
+      mapGeometry = customMap(value, mapGeometry.pixelHeight, TILE_SIZE);
+    } else if (flag == "--height") {
+      mapGeometry = customMap(mapGeometry.pixelWidth, value, TILE_SIZE);
+    } else {
+      log("Unknown option: " + flag);
+    }
   }
 }
 
 // Initialize game board with empty tiles
 void initializeGameState() 
 {
-  int rows = BOARD_HEIGHT / TILE_SIZE;
-  int cols = BOARD_WIDTH / TILE_SIZE;
-  gameState.board.resize(rows, std::vector<std::string>(cols, "white"));
-
-  for (int y = 0; y < rows; ++y) {
-    for (int x = 0; x < cols; ++x) {
-      Tile tile;
-      tile.x = x;
-      tile.y = y;
-      tile.color = "#696969";
-
-      gameState.board[y][x] = tile.color;
-      gameState.changedTiles.push_back(tile);
-    }
+  int rows = mapGeometry.rows;
+  int cols = mapGeometry.cols;
+  // Either way every chunk is released and every tile is resent on the next broadcast
+  if (gameState.board.cols() != cols || gameState.board.rows() != rows) {
+    gameState.board.resize(cols, rows);
+  } else {
+    gameState.board.reset();
+  }
+  gameState.entities->resizeGrid(cols, rows, largestEntityRadius());
+  gameState.influence.resize(cols, rows, INFLUENCE_CELL_SIZE, CITY_SPACING, cityStats.size + CITY_BUILD_RANGE);
+  gameState.influence.rebuild(*gameState.entities);
+  // Troop midpoints stay on cells a troop fits on without touching a structure
+  int clearance = 0;
+  for (const auto& troop : troopMap) {
+    clearance = std::max(clearance, troop.second.size + 1);
   }
+  pathService.rebuild(*gameState.entities, cols, rows, NAV_CELL_SIZE, clearance);
   log("Game state initialized with " + std::to_string(rows) + " rows and " + std::to_string(cols) + " columns.");
 }
 
+// Ends the running match and starts a fresh one on the same map. Every
+// entity goes, players start over without cities, and everything the match
+// allocated goes back to the pool in a single release.
+void startNewMatch() 
+{
+  // Path searches still running hold handles, they must not resolve in the new store
+  uint32_t generation = gameState.entities->unusedGeneration();
+  gameState.routes.clear();
+  // Even an empty container may hold pool memory (some standard libraries
+  // allocate an unordered_map's sentinel up front), so the old store and
+  // scratch are gone before the release and their replacements are built
+  // after it. Assigning would not do: pmr containers keep their resource.
+  gameState.scratch.reset();
+  gameState.entities.reset();
+  gameState.matchPool.release();
+  gameState.entities.emplace(&gameState.matchPool, generation);
+  gameState.scratch.emplace(&gameState.matchPool);
+
+  for (auto& playerPair : gameState.playerStates) {
+    PlayerState& player = playerPair.second;
+    PlayerState fresh;
+    fresh.socket = player.socket;
+    fresh.coins = STARTING_COINS;
+    player = fresh;
+    sendPlayerStateDeltaToClient(player);
+  }
+  initializeGameState();
+  log("New match started.");
+}
+
+// Spatial grid cells are sized to the biggest thing on the map
+int largestEntityRadius() 
+{
+  int radius = cityStats.size;
+  for (const auto& troop : troopMap) {
+    radius = std::max(radius, troop.second.size);
+  }
+  for (const auto& building : buildingMap) {
+    radius = std::max(radius, building.second.size);
+  }
+  return radius;
+}
+
 void initializeMaps() 
 {
   // SETUP OUR MAPS
   // Troops
   troopMap["Barbarian"] = {
-    0, // id
-    {0, 0}, // midpoint
-    6, // size
-    10, // defense
-    10, // attack
-    {}, // collidingEntities
-    "red", // color
+    {
+      6, // size
+      10, // defense
+      10, // attack
+      "red" // color
+    },
     1, // movement
     1, // attackDistance
     15, // cost
@@ -318,477 +425,315 @@ void initializeMaps()
 
   // Buildings
   buildingMap["coinFarm"] = {
-    0, // id
-    {0, 0}, // midpoint
-    10, // size
-    30, // defense
-    10, // attack
-    {}, // collidingEntities
-    "purple", // color
+    {
+      10, // size
+      30, // defense
+      10, // attack
+      "purple" // color
+    },
     50, // cost
     5, // food
     1 // coins
   };
-  return;
-}
 
-// Function to serialize the game state into a simple string format
-std::string serializeGameStateToString() 
-{
-  std::string result;
-  result += "{\"game\": { \"board\": \"";
-  if (gameState.changedTiles.empty()) {
-    for (int y = 0; y < BOARD_HEIGHT / TILE_SIZE; y++) {
-      for (int x = 0; x < BOARD_WIDTH / TILE_SIZE; x++) {
-        result += std::to_string(x) + "," + std::to_string(y) + "," + gameState.board[y][x] + ";";
-      }
-    }
-  } else {
-    for (const auto& tile : gameState.changedTiles) {
-      result += std::to_string(tile.x) + "," + std::to_string(tile.y) + "," + tile.color + ";";
-    }
-  }
-  result += "\"}}";
-  return result;
+  // Cities
+  cityStats = {
+    20, // size
+    100, // defense
+    10, // attack
+    "yellow" // color
+  };
+
+  // Build the circle stamps for every entity size up front
+  circleStamp(troopMap["Barbarian"].size);
+  circleStamp(buildingMap["coinFarm"].size);
+  circleStamp(cityStats.size);
+  return;
 }
 
 // Function to send game state updates to all clients
 void sendGameStateDeltasToClients() 
 {
-  std::scoped_lock<std::mutex> lock(gameState.stateMutex);
-  if (gameState.changedTiles.empty()) {
+  Board& board = gameState.board.output();
+  gameState.board.composite();
+  if (!board.hasDirtyTiles()) {
     return;
   }
-  std::string gameStateStr = serializeGameStateToString();
-  std::string frame = encodeWebSocketFrame(gameStateStr);
-  for (const auto& client : clients) {
-    int result = send(client.first, frame.c_str(), static_cast<int>(frame.size()), 0);
-    if (result == SOCKET_ERROR) {
-      log("Failed to send to client: " + std::to_string(WSAGetLastError()));
-    }
-  }
-  gameState.changedTiles.clear();
-}
+  // After a reset binary clients resync from the keyframe instead of a tile-by-tile delta
+  bool resync = board.needsFullResync();
 
-void update_game_state(GameState& game_state) 
-{
-  std::scoped_lock<std::mutex> lock(game_state.stateMutex);
+  // Each changed tile is emitted once with its final color for this tick
+  gameState.changedTiles.clear();
+  board.collectDirtyTiles(gameState.changedTiles);
 
-  for (auto& playerPair : game_state.playerStates) {
-    PlayerState& player = playerPair.second;
-    for (auto& city : player.cities) {
-      // Remove destroyed troops
-      city.troops.erase(std::remove_if(city.troops.begin(), city.troops.end(),
-        [](const Troop& troop) { return troop.defense <= 0; }), city.troops.end());
-
-      // Remove destroyed buildings
-      city.buildings.erase(std::remove_if(city.buildings.begin(), city.buildings.end(),
-        [](const Building& building) { return building.defense <= 0; }), city.buildings.end());
-
-      // Check if the city itself is destroyed
-      if (city.defense <= 0) {
-        // Handle city destruction logic here
-        // For simplicity, we can just clear the city's troops and buildings
-        city.troops.clear();
-        city.buildings.clear();
-      }
-    }
-  }
-}
+  // Patch the join keyframe with the chunks that changed this tick
+  std::shared_ptr<const std::string> keyframe = gameState.binaryKeyframe.frame(board);
 
-// Some more game state functions related to moving troops
-void temporarilyRemoveTroopFromGameState(Troop* troop) 
-{
-  if (!troop || troop->midpoint.size() < 2) return;
 
-  // Temporarily set the troop's coordinates to an off-board value
-  troop->midpoint[0] = -1;
-  troop->midpoint[1] = -1;
-}
+  // Frames are only built for the protocols that connected clients actually use
+  std::shared_ptr<const std::string> textFrame;
+  std::shared_ptr<const std::string> binaryFrame;
+  std::shared_ptr<const std::string> paletteFrame;
+  int paletteSize = ColorRegistry::getInstance().size();
+  bool paletteChanged = paletteSize != paletteSizeSent;
 
-void clearCollidingEntities() 
-{
-  std::scoped_lock<std::mutex> lock(gameState.stateMutex);
+  for (const auto& client : clients) {
+    bool isBinary = binaryClients.count(client.first) > 0;
+    if (isBinary && resync) {
+      // The keyframe already carries the palette
+      queueFrame(client.first, keyframe);
+      continue;
+    }
+    if (isBinary && paletteChanged) {
+      if (!paletteFrame) {
+        paletteFrame = std::make_shared<const std::string>(encodeWebSocketFrame(encodePaletteBinary(), WS_OPCODE_BINARY));
+      }
+      queueFrame(client.first, paletteFrame);
+    }
 
-  for (auto& playerPair : gameState.playerStates) {
-    PlayerState& player = playerPair.second;
-    for (auto& city : player.cities) {
-      city.collidingEntities.clear();
-      for (auto& troop : city.troops) {
-        troop.collidingEntities.clear();
+    if (isBinary) {
+      if (!binaryFrame) {
+        binaryFrame = std::make_shared<const std::string>(encodeWebSocketFrame(encodeTilesBinary(gameState.changedTiles, board.cols(), board.rows()), WS_OPCODE_BINARY));
       }
-      for (auto& building : city.buildings) {
-        building.collidingEntities.clear();
+      queueFrame(client.first, binaryFrame);
+    } else {
+      if (!textFrame) {
+        textFrame = std::make_shared<const std::string>(encodeWebSocketFrame(serializeTilesToString(gameState.changedTiles)));
       }
+      queueFrame(client.first, textFrame);
     }
   }
+  paletteSizeSent = paletteSize;
 }
 
-int changeGridPoint(int x, int y, const std::string color) 
-{
-  if (color != "#696969") 
-    std::scoped_lock<std::mutex> lock(gameState.stateMutex);
+// Some more game state functions related to moving troops
 
-  if (x >= 0 && x < BOARD_WIDTH / TILE_SIZE && y >= 0 && y < BOARD_HEIGHT / TILE_SIZE) {
-    gameState.board[y][x] = color;
-    gameState.changedTiles.push_back({ x, y, color });
-  } else {
-    log("Invalid grid point (" + std::to_string(x) + ", " + std::to_string(y) + "). No changes made.");
-    return 1;
-  }
-  return 0;
-}
 
-// Functionality to insert a character using the bresenham's circle generation algorithm
-int insertCharacter(std::vector<int> coords, int radius, const std::string color, int ignoreId = -1) 
+// Functionality to insert a character by stamping its cached circle spans onto its board layer
+int insertCharacter(std::vector<int> coords, int radius, const std::string color, BoardLayer layer, int ignoreId = -1, StampMode mode = StampMode::Filled) 
 {
   int centerX = coords[0];
   int centerY = coords[1];
-  int d = 3 - 2 * radius;
-  int y = radius;
-  int x = 0;
 
   std::vector<int> circle = { coords[0], coords[1], radius };
+  ColorIndex colorIdx = colorIndex(color);
 
-  log("Creating a character at (" + std::to_string(centerX) + ", " + std::to_string(centerY) + ")");
-  if (color != "#696969") {
-    if (checkCollision(circle, ignoreId)) {
-      log("Collision detected at (" + std::to_string(centerX) + ", " + std::to_string(centerY) + ")");
-      return 0;
-    }
+  if (colorIdx != BACKGROUND_COLOR && checkCollision(circle, ignoreId)) {
+    return 0;
   }
 
-  while (y >= x) {
-    changeGridPoint(centerX + x, centerY + y, color);
-    changeGridPoint(centerX - x, centerY + y, color);
-    changeGridPoint(centerX + x, centerY - y, color);
-    changeGridPoint(centerX - x, centerY - y, color);
-    changeGridPoint(centerX + y, centerY + x, color);
-    changeGridPoint(centerX - y, centerY + x, color);
-    changeGridPoint(centerX + y, centerY - x, color);
-    changeGridPoint(centerX - y, centerY - x, color);
-
-    x++;
-    if (d > 0) {
-      y--;
-      d = d + 4 * (x - y) + 10;
-    } else {
-      d = d + 4 * x + 6;
-    }
-  }
+  gameState.board.drawCircle(layer, centerX, centerY, radius, colorIdx, mode);
   return 1;
 }
 
-int updateEntityMidpoint(SOCKET playerSocket, const std::vector<int>& oldMidpoint, const std::vector<int>& newMidpoint) 
+// Clears a character from its layer, revealing whatever lies underneath
+void eraseCharacter(const std::vector<int>& coords, int radius, BoardLayer layer) 
 {
-  std::scoped_lock<std::mutex> lock(gameState.stateMutex);
-
-  auto it = gameState.playerStates.find(playerSocket);
-  if (it == gameState.playerStates.end()) {
-    log("Player not found in game state.");
-    return 0;
-  }
-
-  PlayerState& playerState = it->second;
-
-  for (auto& city : playerState.cities) {
-    if (city.midpoint == oldMidpoint) {
-      city.midpoint = newMidpoint;
-      return 1;
-    }
-    for (auto& troop : city.troops) {
-      if (troop.midpoint == oldMidpoint) {
-        troop.midpoint = newMidpoint;
-        return 1;
-      }
-    }
-    for (auto& building : city.buildings) {
-      if (building.midpoint == oldMidpoint) {
-        building.midpoint = newMidpoint;
-        return 1;
-      }
-    }
-  }
-  log("Entity with the specified midpoint not found.");
-  return 0;
+  if (coords.size() < 2) return;
+  gameState.board.eraseCircle(layer, coords[0], coords[1], radius, StampMode::Filled);
 }
 
-
-void removeEntityFromGameState(GameState& gameState, PlayerState& playerState, int entityId)
+// Position of a live entity, empty once it is gone
+std::vector<int> midpointOf(EntityHandle handle) 
 {
-  log("Attempting to remove entity with ID: " + std::to_string(entityId));
-
-  for (auto& city : playerState.cities) {
-    if (city.id == entityId) {
-      log("City found. Removing city from the game state.");
+  int index = gameState.entities->indexOf(handle);
+  if (index < 0) return {};
+  return { gameState.entities->xs[index], gameState.entities->ys[index] };
+}
 
-      // Clear the board of the city using its midpoint
-      std::vector<int> midpoint = city.midpoint;
-      insertCharacter(midpoint, city.size, "#696969", entityId);
 
-      // Clear the city's troops and buildings
-      for (auto& troop : city.troops) {
-        insertCharacter(troop.midpoint, troop.size, "#696969", troop.id);
-      }
-      for (auto& building : city.buildings) {
-        insertCharacter(building.midpoint, building.size, "#696969", building.id);
+// Clears an entity from the board and the store. A city takes its troops
+// and buildings with it.
+void removeEntityFromGameState(GameState& gameState, EntityHandle handle)
+{
+  EntityStore& entities = *gameState.entities;
+  int index = entities.indexOf(handle);
+  if (index < 0) {
+    log("Entity to remove no longer exists.");
+    return;
+  }
+  int entityId = entities.ids[index];
+  EntityType type = entities.types[index];
+  log("Removing entity with ID: " + std::to_string(entityId));
+
+  if (type == EntityType::City) {
+    auto player = gameState.playerStates.find(static_cast<SOCKET>(entities.owners[index]));
+    if (player != gameState.playerStates.end()) {
+      for (auto& city : player->second.cities) {
+        if (city.handle != handle) continue;
+        for (EntityHandle troop : city.troops) {
+          removeEntityFromGameState(gameState, troop);
+        }
+        for (EntityHandle building : city.buildings) {
+          removeEntityFromGameState(gameState, building);
+        }
+        city.troops.clear();
+        city.buildings.clear();
       }
-      city.troops.clear();
-      city.buildings.clear();
-
-      // Clear the city's midpoint to mark it as removed
-      city.midpoint.clear();
-
-      log("City " + std::to_string(entityId) + " removed from game state.");
-      update_game_state(gameState); // Update game state after removal
-      return;
     }
+    index = entities.indexOf(handle); // Removing the others may have moved the city
+  }
 
-    auto troopIt = std::find_if(city.troops.begin(), city.troops.end(), [entityId](const Troop& troop) {
-      return troop.id == entityId;
-      });
-
-    if (troopIt != city.troops.end()) {
-      log("Troop found. Removing troop from the game state.");
-
-      // Clear the board of the troop using its midpoint
-      std::vector<int> midpoint = troopIt->midpoint;
-      insertCharacter(midpoint, troopIt->size, "#696969", entityId);
-
-      // Remove the troop from the city's troop list
-      city.troops.erase(troopIt);
-
-      log("Troop " + std::to_string(entityId) + " removed from game state.");
-      update_game_state(gameState); // Update game state after removal
-      return;
-    }
-
-    auto buildingIt = std::find_if(city.buildings.begin(), city.buildings.end(), [entityId](const Building& building) {
-      return building.id == entityId;
-      });
-
-    if (buildingIt != city.buildings.end()) {
-      log("Building found. Removing building from the game state.");
-
-      // Clear the board of the building using its midpoint
-      std::vector<int> midpoint = buildingIt->midpoint;
-      insertCharacter(midpoint, buildingIt->size, "#696969", entityId);
+  BoardLayer layer = type == EntityType::Troop ? BoardLayer::Units : BoardLayer::Structures;
+  std::vector<int> midpoint = midpointOf(handle);
+  eraseCharacter(midpoint, entities.radii[index], layer);
+  if (type == EntityType::Troop) {
+    gameState.routes.erase(entityId);
+  } else {
+    pathService.structureRemoved(midpoint[0], midpoint[1], entities.radii[index]);
+  }
+  entities.destroy(handle);
+  if (type == EntityType::City) {
+    gameState.influence.cityChanged(entities, midpoint[0], midpoint[1]);
+  }
+  log("Entity " + std::to_string(entityId) + " removed from game state.");
+}
 
-      // Remove the building from the city's building list
-      city.buildings.erase(buildingIt);
 
-      log("Building " + std::to_string(entityId) + " removed from game state.");
-      update_game_state(gameState); // Update game state after removal
-      return;
+// Drops the handles of entities that no longer exist from every city
+void pruneDeadHandles(GameState& gameState)
+{
+  const EntityStore& entities = *gameState.entities;
+  auto isGone = [&entities](EntityHandle handle) { return !entities.isAlive(handle); };
+  for (auto& playerPair : gameState.playerStates) {
+    for (auto& city : playerPair.second.cities) {
+      city.troops.erase(std::remove_if(city.troops.begin(), city.troops.end(), isGone), city.troops.end());
+      city.buildings.erase(std::remove_if(city.buildings.begin(), city.buildings.end(), isGone), city.buildings.end());
     }
   }
-
-  log("Entity with ID " + std::to_string(entityId) + " not found in any city.");
 }
 
+// How far past its midpoint a troop can hit, the target's radius comes on top
+int attackReach(const EntityStore& entities, int index)
+{
+  return entities.radii[index] + CONTACT_GAP + static_cast<const Troop*>(entities.kinds[index])->attackDistance;
+}
 
-void handleTroopCollisions() 
+bool inAttackRange(const EntityStore& entities, int index, int target)
 {
-  std::vector<PlayerState> playerStates;
-  {
-    std::scoped_lock<std::mutex> lock(gameState.stateMutex);
-    for (const auto& playerPair : gameState.playerStates) {
-      playerStates.push_back(playerPair.second);
-    }
-  }
+  int64_t dx = entities.xs[target] - entities.xs[index];
+  int64_t dy = entities.ys[target] - entities.ys[index];
+  int64_t limit = attackReach(entities, index) + entities.radii[target];
+  return dx * dx + dy * dy <= limit * limit;
+}
 
-  for (auto& player : playerStates) {
-    for (auto& city : player.cities) {
-      for (auto& troop : city.troops) {
-        applyDamageToCollidingEntities(player.socket, &troop);
+// Target acquisition pass of the board tick. A troop keeps its target
+// while the target lives, stays in range and the troop stays in the same
+// grid cell, so armies already locked in a fight skip the spatial query.
+// A troop that found nothing skips it too until something changes in the
+// grid cells its query covers. Otherwise it picks the closest enemy within attackDistance of its edge,
+// ties going to the lower index so every tick agrees.
+void acquireTargets() 
+{
+  EntityStore& entities = *gameState.entities;
+
+  HandleList& candidates = gameState.scratch->candidates;
+  for (int i = 0; i < entities.size(); i++) {
+    if (entities.types[i] != EntityType::Troop) continue;
+    int cell = entities.cellOf(i);
+    int reach = attackReach(entities, i);
+    int current = entities.indexOf(entities.targets[i]);
+    if (current >= 0 && entities.targetCells[i] == cell && inAttackRange(entities, i, current)) continue;
+    // Nothing was in range from this cell last time, and nothing the query
+    // would look at has appeared, moved or gone since
+    if (current < 0 && cell >= 0 && entities.targetCells[i] == cell &&
+        entities.changedNear(entities.xs[i], entities.ys[i], reach) <= entities.targetSearches[i]) continue;
+
+    candidates.clear();
+    entities.queryRadius(entities.xs[i], entities.ys[i], reach, notOwnedBy(entities.owners[i]), candidates, true);
+    int best = -1;
+    int64_t bestDistance = 0;
+    for (EntityHandle candidate : candidates) {
+      int index = entities.indexOf(candidate);
+      int64_t dx = entities.xs[index] - entities.xs[i];
+      int64_t dy = entities.ys[index] - entities.ys[i];
+      int64_t distance = dx * dx + dy * dy;
+      if (best < 0 || distance < bestDistance || (distance == bestDistance && index < best)) {
+        best = index;
+        bestDistance = distance;
       }
     }
+    entities.targets[i] = best >= 0 ? entities.handleAt(best) : EntityHandle();
+    entities.targetCells[i] = cell;
+    entities.targetSearches[i] = entities.gridVersion();
   }
 }
 
-void applyDamageToCollidingEntities(SOCKET playerSocket, CollidableEntity* entity)
+// Combat phase of the board tick. Every troop strikes its target, and a
+// city or building under attack strikes back at each troop attacking it.
+// All hits are gathered first and their damage summed per entity, so the
+// result does not depend on which entity moved last, then everything left
+// without defense is removed in one pass.
+void resolveCombat() 
 {
-  PlayerState* ourPlayer;
-  {
-    std::scoped_lock<std::mutex> lock(gameState.stateMutex);
-    ourPlayer = &gameState.playerStates[playerSocket];
-  }
-
-  log("Our player: " + std::to_string(ourPlayer->socket));
-
-  log("Applying damage for moving entity " + std::to_string(entity->id) + " (Client: " + std::to_string(playerSocket) + ")");
-
-  for (auto& playerPair : gameState.playerStates) {
-    PlayerState& player = playerPair.second;
-    log("Testing against player: " + std::to_string(playerPair.first));
-    if (playerPair.first == playerSocket) {
-      log("Skipping our own player.");
-      continue;
+  EntityStore& entities = *gameState.entities;
+  std::pmr::vector<std::pair<int, int>>& contacts = gameState.scratch->contacts;
+  std::pmr::vector<int>& damage = gameState.scratch->damage;
+
+  contacts.clear();
+  for (int i = 0; i < entities.size(); i++) {
+    if (entities.types[i] != EntityType::Troop) continue;
+    int target = entities.indexOf(entities.targets[i]);
+    if (target >= 0) {
+      contacts.push_back({ i, target });
     }
-    for (auto& city : player.cities) {
-      log("Testing against city: " + std::to_string(city.id) + " with size: " + std::to_string(city.size));
-      log("Entity size: " + std::to_string(entity->size));
-      int newRadius = entity->size + city.size + 4;
-      if (isWithinRadius(city.midpoint, entity->midpoint, newRadius)) {
-        int cityDamage = entity->attack;
-        int movingEntityDamage = city.attack;
-        city.defense -= cityDamage;
-        entity->defense -= movingEntityDamage;
-        entity->collidingEntities.push_back(city.id);
-        city.collidingEntities.push_back(entity->id);
-        log("Entity " + std::to_string(entity->id) + " (Client: " + std::to_string(playerSocket) + ") dealt " + std::to_string(cityDamage) + " damage to City " + std::to_string(city.id) + " (Client: " + std::to_string(playerPair.first) + "). City defense: " + std::to_string(city.defense));
-        log("City " + std::to_string(city.id) + " (Client: " + std::to_string(playerPair.first) + ") dealt " + std::to_string(movingEntityDamage) + " damage to Entity " + std::to_string(entity->id) + " (Client: " + std::to_string(playerSocket) + "). Entity defense: " + std::to_string(entity->defense));
-
-        if (city.defense <= 0) {
-          log("City " + std::to_string(city.id) + " (Client: " + std::to_string(playerPair.first) + ") has been destroyed.");
-          removeEntityFromGameState(gameState, player, city.id);
-        }
+  }
 
-        if (entity->defense <= 0) {
-          log("Entity " + std::to_string(entity->id) + " (Client: " + std::to_string(playerSocket) + ") has been destroyed.");
-          removeEntityFromGameState(gameState, *ourPlayer, entity->id);
-          return;
-        }
-      }
-      for (auto& troop : city.troops) {
-        log("Testing against troop: " + std::to_string(troop.midpoint[0]) + ", " + std::to_string(troop.midpoint[1]) + " : " + std::to_string(entity->midpoint[0]) + ", " + std::to_string(entity->midpoint[1]));
-        std::vector<int> circleOne, circleTwo;
-        int newRadius = (troop.size + entity->size) + 4;
-        log(std::to_string(isWithinRadius(troop.midpoint, entity->midpoint, newRadius)));
-        if (isWithinRadius(troop.midpoint, entity->midpoint, newRadius)) {
-          log("Troops are officially fighting");
-          int troopDamage = entity->attack;
-          int movingEntityDamage = troop.attack;
-          troop.defense -= troopDamage;
-          entity->defense -= movingEntityDamage;
-          entity->collidingEntities.push_back(troop.id);
-          troop.collidingEntities.push_back(entity->id);
-          log("Entity " + std::to_string(entity->id) + " (Client: " + std::to_string(playerSocket) + ") dealt " + std::to_string(troopDamage) + " damage to Troop " + std::to_string(troop.id) + " (Client: " + std::to_string(playerPair.first) + "). Troop defense: " + std::to_string(troop.defense));
-          log("Troop " + std::to_string(troop.id) + " (Client: " + std::to_string(playerPair.first) + ") dealt " + std::to_string(movingEntityDamage) + " damage to Entity " + std::to_string(entity->id) + " (Client: " + std::to_string(playerSocket) + "). Entity defense: " + std::to_string(entity->defense));
-
-          // Remove troop if its defense is zero or less
-          if (troop.defense <= 0) {
-            log("Troop " + std::to_string(troop.id) + " (Client: " + std::to_string(playerPair.first) + ") has been destroyed.");
-            insertCharacter(troop.midpoint, troop.size, "#696969", troop.id); // Overwrite the spot on the board
-            city.troops.erase(std::remove_if(city.troops.begin(), city.troops.end(), [&](const Troop& t) { return t.id == troop.id; }), city.troops.end());
-          }
+  std::fill(entities.colliding.begin(), entities.colliding.end(), 0);
+  if (contacts.empty()) return;
 
-          if (entity->defense <= 0) {
-            log("Our troop is dead");
-            removeEntityFromGameState(gameState, *ourPlayer, entity->id);
-            update_game_state(gameState); // Update game state after removal
-            return;
-          }
-        }
-      }
-      for (auto& building : city.buildings) {
-        std::vector<int> circleOne, circleTwo;
-        int newRadius = (building.size + entity->size) + 4;
-        log(std::to_string(isWithinRadius(building.midpoint, entity->midpoint, newRadius)));
-        if (isWithinRadius(building.midpoint, entity->midpoint, newRadius)) {
-          log("building is officially fighting");
-          int buildingDamage = entity->attack;
-          int movingEntityDamage = building.attack;
-          building.defense -= buildingDamage;
-          entity->defense -= movingEntityDamage;
-          entity->collidingEntities.push_back(building.id);
-          building.collidingEntities.push_back(entity->id);
-          log("Entity " + std::to_string(entity->id) + " (Client: " + std::to_string(playerSocket) + ") dealt " + std::to_string(movingEntityDamage) + " damage to Troop " + std::to_string(building.id) + " (Client: " + std::to_string(playerPair.first) + "). Building defense: " + std::to_string(building.defense));
-          log("Building " + std::to_string(building.id) + " (Client: " + std::to_string(playerPair.first) + ") dealt " + std::to_string(buildingDamage) + " damage to Entity " + std::to_string(entity->id) + " (Client: " + std::to_string(playerSocket) + "). Entity defense: " + std::to_string(entity->defense));
-
-          // Remove troop if its defense is zero or less
-          if (building.defense <= 0) {
-            log("Building " + std::to_string(building.id) + " (Client: " + std::to_string(playerPair.first) + ") has been destroyed.");
-            insertCharacter(building.midpoint, building.size, "#696969", building.id); // Overwrite the spot on the board
-            city.buildings.erase(std::remove_if(city.buildings.begin(), city.buildings.end(), [&](const Building& t) { return t.id == building.id; }), city.buildings.end());
-          }
+  for (const auto& contact : contacts) {
+    entities.colliding[contact.first] = 1;
+    entities.colliding[contact.second] = 1;
+  }
 
-          if (entity->defense <= 0) {
-            log("Our troop is dead");
-            removeEntityFromGameState(gameState, *ourPlayer, entity->id);
-            update_game_state(gameState); // Update game state after removal
-            return;
-          }
-        }
-      }
-    }
+  // Everyone in a fight strikes STRIKES_PER_SECOND times a second, whatever
+  // the tick rate, carrying the remainder over like movement does
+  std::pmr::vector<int>& strikes = gameState.scratch->strikes;
+  strikes.assign(entities.size(), 0);
+  for (int i = 0; i < entities.size(); i++) {
+    if (!entities.colliding[i]) continue;
+    entities.attackProgress[i] += STRIKES_PER_SECOND;
+    strikes[i] = entities.attackProgress[i] / tickRate;
+    entities.attackProgress[i] %= tickRate;
   }
 
-  // Remove moving entity if its defense is zero or less
-  if (entity->defense <= 0) {
-    log("Entity " + std::to_string(entity->id) + " (Client: " + std::to_string(playerSocket) + ") has been destroyed.");
-    removeEntityFromGameState(gameState, *ourPlayer, entity->id);
-    update_game_state(gameState);
-    insertCharacter(entity->midpoint, entity->size, "#696969", entity->id); // Overwrite the spot on the board
-    for (auto& city : ourPlayer->cities) {
-      city.troops.erase(std::remove_if(city.troops.begin(), city.troops.end(), [&](const Troop& t) { return t.id == entity->id; }), city.troops.end());
+  damage.assign(entities.size(), 0);
+  for (const auto& contact : contacts) {
+    damage[contact.second] += entities.attacks[contact.first] * strikes[contact.first];
+    if (entities.types[contact.second] != EntityType::Troop) {
+      damage[contact.first] += entities.attacks[contact.second] * strikes[contact.second];
     }
   }
-  update_game_state(gameState); // Update game state after applying damage
-}
-
-
-
-
-
-// Collision logic and functions
-void checkForCollidingTroops() 
-{
-  std::scoped_lock<std::mutex> lock(gameState.stateMutex);
 
-  for (auto& player: gameState.playerStates) {
-    PlayerState& playerState = player.second;
-    for (auto& cities : playerState.cities) {
-      for (auto& troops : cities.troops) {
-        log("Troop: " + std::to_string(troops.id));
-      }
+  HandleList& destroyed = gameState.scratch->destroyed;
+  destroyed.clear();
+  for (int i = 0; i < entities.size(); i++) {
+    if (damage[i] == 0) continue;
+    entities.defenses[i] -= damage[i];
+    if (entities.defenses[i] <= 0) {
+      destroyed.push_back(entities.handleAt(i));
     }
   }
+  combatStats.attacks += contacts.size();
+  combatStats.destroyed += destroyed.size();
+
+  for (EntityHandle handle : destroyed) {
+    int index = entities.indexOf(handle);
+    if (index < 0) continue; // Went down with its city
+    log("Entity " + std::to_string(entities.ids[index]) + " (Client: " + std::to_string(entities.owners[index]) + ") has been destroyed.");
+    removeEntityFromGameState(gameState, handle);
+  }
+  pruneDeadHandles(gameState);
 }
 
-int isColliding(std::vector<int> circleOne, std::vector<int> circleTwo) 
-{
-  int xOne = circleOne[0];
-  int yOne = circleOne[1];
-  int radOne = circleOne[2];
-
-  int xTwo = circleTwo[0];
-  int yTwo = circleTwo[1];
-  int radTwo = circleTwo[2];
-
-  int xResult = (xTwo - xOne) * (xTwo - xOne);
-  int yResult = (yTwo - yOne) * (yTwo - yOne);
-  int requiredDistance = radOne + radTwo;
-
-  int actualDistance = static_cast<int>(squareRoot(static_cast<double>(xResult + yResult)));
-
-  log("Checking collision: circleOne (" + std::to_string(xOne) + ", " + std::to_string(yOne) + ", " + std::to_string(radOne) + "), circleTwo (" + std::to_string(xTwo) + ", " + std::to_string(yTwo) + ", " + std::to_string(radTwo) + "), actualDistance: " + std::to_string(actualDistance) + ", requiredDistance: " + std::to_string(requiredDistance));
-
-  if (actualDistance <= requiredDistance)
-    return 1;
-  return 0;
-}
+// Collision logic and functions
 
-std::shared_ptr<Troop> findNearestTroop(PlayerState& player, const std::vector<int>& coords) 
+EntityHandle findNearestTroop(PlayerState& player, const std::vector<int>& coords) 
 {
-  std::shared_ptr<Troop> nearestTroop = nullptr;
-  int minDistance = std::numeric_limits<int>::max();
-
-  for (auto& city : player.cities) {
-    if (city.midpoint.empty()) continue; // Skip uninitialized cities
-    for (auto& troop : city.troops) {
-      if (troop.midpoint.size() < 2) continue; // Skip uninitialized troops
-        int dx = coords[0] - troop.midpoint[0];
-        int dy = coords[1] - troop.midpoint[1];
-        int distance = dx * dx + dy * dy;
-        if (distance < minDistance) {
-          minDistance = distance;
-          nearestTroop = std::make_shared<Troop>(troop);
-      }
-    }
-  }
-
-  return nearestTroop;
+  HandleList nearest;
+  gameState.entities->nearest(coords[0], coords[1], 1, ownedBy(static_cast<EntityOwner>(player.socket), EntityType::Troop), nearest);
+  return nearest.empty() ? EntityHandle() : nearest[0];
 }
 
 bool isWithinRadius(const std::vector<int>& point, const std::vector<int>& center, int radius) 
@@ -814,167 +759,154 @@ bool isWithinRadius(const std::vector<int>& point, const std::vector<int>& cente
 
 int checkCollision(const std::vector<int>& circleOne, int ignoreId = -1) 
 {
-  std::scoped_lock<std::mutex> lock(gameState.stateMutex);
-
-  log("Checking collision for circle with ignoreId: " + std::to_string(ignoreId));
-
-  bool hasCircles = false;
-  for (const auto& playerPair : gameState.playerStates) {
-    const PlayerState& player = playerPair.second;
-    for (const auto& city : player.cities) {
-      if (!city.midpoint.empty()) {
-        hasCircles = true;
-        break;
-      }
-    }
-    if (hasCircles)
-      break;
-  }
-
-  if (!hasCircles)
-    return 0;
-
-  for (const auto& playerPair : gameState.playerStates) {
-    const PlayerState& player = playerPair.second;
-    for (const auto& troop : player.cities->troops) {
-      if (!troop.midpoint.empty() && troop.id != ignoreId) {
-        std::vector<int> circleTwo = { troop.midpoint[0], troop.midpoint[1], troop.size };
-        if (isColliding(circleOne, circleTwo)) {
-          log("Collision detected between entity " + std::to_string(ignoreId) + " and troop " + std::to_string(troop.id));
-          return 1;
-        }
-      }
-    }
-    for (const auto& building : player.cities->buildings) {
-      if (!building.midpoint.empty()) {
-        std::vector<int> circleTwo = { building.midpoint[0], building.midpoint[1], building.size };
-        if (isColliding(circleOne, circleTwo)) {
-          log("Collision detected between entity " + std::to_string(ignoreId) + " and building " + std::to_string(building.id));
-          return 1;
-        }
-      }
-    }
-    for (const auto& city : player.cities) {
-      if (!city.midpoint.empty()) {
-        std::vector<int> circleTwo = { city.midpoint[0], city.midpoint[1], city.size };
-        if (isColliding(circleOne, circleTwo)) {
-          log("Collision detected between entity " + std::to_string(ignoreId) + " and city " + std::to_string(city.id));
-          return 1;
-        }
-      }
-    }
-  }
-  return 0;
+  // Tested against the occupancy bitmap, entities are only looked up on a hit
+  int hit = gameState.entities->findOverlap(circleOne[0], circleOne[1], circleOne[2], ignoreId);
+  return hit >= 0 ? 1 : 0;
 }
 
 // Character movement functionality below 
-bool moveCharacter(SOCKET playerSocket, CollidableEntity* entityToMove, const std::vector<int>& newCoords) 
-{
-  if (!entityToMove || entityToMove->midpoint.size() < 2) {
-    log("Invalid entity to move.");
-    return false;
-  }
-
-  int currentX = entityToMove->midpoint[0];
-  int currentY = entityToMove->midpoint[1];
-  int radius = entityToMove->size;
-  std::string color = entityToMove->color;
-  int entityId = entityToMove->id;
-
-  std::vector<int> currentCoords = { currentX, currentY };
-
-  log("Moving entity " + std::to_string(entityId) + " (Client: " + std::to_string(playerSocket) + ") from (" + std::to_string(currentX) + ", " + std::to_string(currentY) + ") to (" + std::to_string(newCoords[0]) + ", " + std::to_string(newCoords[1]) + ")");
 
-  // Check for collision at the new coordinates
-  std::vector<int> newCircle = { newCoords[0], newCoords[1], radius };
-  if (checkCollision(newCircle, entityId)) {
-    log("Collision detected at (" + std::to_string(newCoords[0]) + ", " + std::to_string(newCoords[1]) + ")");
-    return false;
+// Next tile a walking troop at position heads for, false once it has
+// arrived at goal. Flow fields are sampled afresh from every cell.
+bool nextWaypoint(Route& route, NavPoint position, NavPoint goal, NavPoint& waypoint)
+{
+  if (route.field) {
+    if (position == goal) return false;
+    waypoint = route.field->next(position.x, position.y, goal);
+    return true;
   }
-
-  // Clear the old position on the board
-  insertCharacter(currentCoords, radius, "#696969", entityId);
-
-  // Insert the entity at the new position
-  insertCharacter(newCoords, radius, color, entityId);
-
-  // Update the entity's position in the global game state
-  int res = updateEntityMidpoint(playerSocket, currentCoords, newCoords);
-
-  // Update the entity's midpoint in the local entity object
-  entityToMove->midpoint = newCoords;
-
-  // Add the changed tiles to the changedTiles vector
-  {
-    std::scoped_lock<std::mutex> lock(gameState.stateMutex);
-    gameState.changedTiles.push_back({ currentX, currentY, "#696969" });
-    gameState.changedTiles.push_back({ newCoords[0], newCoords[1], color });
+  while (route.next < route.waypoints.size() && route.waypoints[route.next] == position) {
+    route.next++;
   }
-  // Send game state deltas to clients
-  sendGameStateDeltasToClients();
-
+  if (route.next == route.waypoints.size()) return false;
+  waypoint = route.waypoints[route.next];
   return true;
 }
 
-void moveTroopToPosition(SOCKET playerSocket, std::shared_ptr<Troop> troop, const std::vector<int>& targetCoords)
+// Movement phase of the board tick. Routes the path service finished
+// since the last tick are handed to their troops first; a troop whose
+// search failed heads straight for its goal. Every walking troop earns
+// movement tiles MOVE_STEPS_PER_SECOND times a second, whatever the tick
+// rate, and walks them from waypoint to waypoint, or cell to cell along a
+// flow field, in one sweep per leg:
+// diagonally until one axis lines up with the waypoint, then straight.
+// The order ends when the troop arrives or something blocks it, whatever
+// is in the way is left to the combat phase. Behind a friendly troop with
+// the same goal it waits instead, so a group moves as a column, for up to
+// MAX_WAIT_SECONDS without taking a step.
+void advanceMovement() 
 {
-  while (troop->midpoint != targetCoords) {
-    {
-      std::scoped_lock<std::mutex> lock(gameState.stateMutex);
-      PlayerState& player = gameState.playerStates[playerSocket];
-      bool troopExists = false;
-
-      // Check if the troop still exists in the game state
-      for (auto& city : player.cities) {
-        auto it = std::find_if(city.troops.begin(), city.troops.end(), [&](const Troop& t) {
-          return t.id == troop->id;
-          });
-        if (it != city.troops.end()) {
-          troopExists = true;
-          break;
-        }
-      }
-
-      if (!troopExists) {
-        log("Troop " + std::to_string(troop->id) + " no longer exists in the game state.");
-        return;
-      }
-    } // Mutex is unlocked here
-
-    std::vector<int> currentCoords = troop->midpoint;
-    std::vector<int> nextCoords = currentCoords;
-
-    if (currentCoords[0] < targetCoords[0]) nextCoords[0]++;
-    else if (currentCoords[0] > targetCoords[0]) nextCoords[0]--;
-
-    if (currentCoords[1] < targetCoords[1]) nextCoords[1]++;
-    else if (currentCoords[1] > targetCoords[1]) nextCoords[1]--;
-
-    log("Attempting to move troop " + std::to_string(troop->id) + " (Client: " + std::to_string(playerSocket) + ") from (" + std::to_string(currentCoords[0]) + ", " + std::to_string(currentCoords[1]) + ") to (" + std::to_string(nextCoords[0]) + ", " + std::to_string(nextCoords[1]) + ")");
+  EntityStore& entities = *gameState.entities;
+
+  std::vector<PathResult>& paths = gameState.scratch->paths;
+  paths.clear();
+  pathService.collect(paths);
+  for (PathResult& path : paths) {
+    int i = entities.indexOf(path.unit);
+    // Gone, or given another order while this one was searched
+    if (i < 0 || entities.moving[i] != MoveState::Pathing || entities.orderXs[i] != path.goal.x || entities.orderYs[i] != path.goal.y) continue;
+    Route& route = gameState.routes[entities.ids[i]];
+    route.next = 0;
+    route.field = path.field;
+    if (path.field) {
+      route.waypoints.clear();
+      log("Troop " + std::to_string(entities.ids[i]) + " following the flow field to (" + std::to_string(path.goal.x) + ", " + std::to_string(path.goal.y) + ")" + (path.cached ? " (cached)." : "."));
+    } else if (path.status == PathStatus::Found) {
+      route.waypoints = std::move(path.waypoints);
+      log("Troop " + std::to_string(entities.ids[i]) + " routed through " + std::to_string(route.waypoints.size()) + " waypoints" + (path.cached ? " (cached)." : "."));
+    } else {
+      route.waypoints.assign(1, path.goal);
+      log("Troop " + std::to_string(entities.ids[i]) + (path.status == PathStatus::TimedOut ? " path search timed out" : " has no path") + ", heading straight for (" + std::to_string(path.goal.x) + ", " + std::to_string(path.goal.y) + ")");
+    }
+    entities.moving[i] = MoveState::Walking;
+    entities.waitTicks[i] = 0;
+  }
 
-    // Check for collision at the next coordinates
-    std::vector<int> newCircle = { nextCoords[0], nextCoords[1], troop->size };
-    if (checkCollision(newCircle, troop->id)) {
-      log("Collision detected at (" + std::to_string(nextCoords[0]) + ", " + std::to_string(nextCoords[1]) + ")");
-      applyDamageToCollidingEntities(playerSocket, troop.get());
-      return;
+  for (int i = 0; i < entities.size(); i++) {
+    if (entities.moving[i] != MoveState::Walking) continue;
+    auto found = gameState.routes.find(entities.ids[i]);
+    if (found == gameState.routes.end()) {
+      entities.moving[i] = MoveState::Idle;
+      continue;
+    }
+    Route& route = found->second;
+    entities.moveProgress[i] += static_cast<const Troop*>(entities.kinds[i])->movement * MOVE_STEPS_PER_SECOND;
+    int remaining = entities.moveProgress[i] / tickRate;
+    entities.moveProgress[i] %= tickRate;
+    if (remaining == 0) {
+      if (entities.waitTicks[i] > 0) entities.waitTicks[i]++; // Still waiting between steps
+      continue;
     }
 
-    if (!moveCharacter(playerSocket, troop.get(), nextCoords)) {
-      log("Failed to move troop " + std::to_string(troop->id) + " (Client: " + std::to_string(playerSocket) + ") to (" + std::to_string(nextCoords[0]) + ", " + std::to_string(nextCoords[1]) + ")");
-      return;
+    int x = entities.xs[i];
+    int y = entities.ys[i];
+    int nextX = x;
+    int nextY = y;
+    NavPoint goal = { entities.orderXs[i], entities.orderYs[i] };
+    NavPoint waypoint;
+    bool blocked = false;
+    int hit = -1;
+    while (remaining > 0 && !blocked && nextWaypoint(route, { nextX, nextY }, goal, waypoint)) {
+      int dx = waypoint.x - nextX;
+      int dy = waypoint.y - nextY;
+      int stepX = (dx > 0) - (dx < 0);
+      int stepY = (dy > 0) - (dy < 0);
+      int length = stepX && stepY ? std::min(std::abs(dx), std::abs(dy)) : std::max(std::abs(dx), std::abs(dy));
+      int steps = std::min(length, remaining);
+      int taken = entities.sweep(nextX, nextY, entities.radii[i], stepX, stepY, steps, entities.ids[i], hit);
+      nextX += stepX * taken;
+      nextY += stepY * taken;
+      remaining -= steps;
+      blocked = taken < steps;
+    }
+    bool arrived = !blocked && !nextWaypoint(route, { nextX, nextY }, goal, waypoint);
+    // Stuck behind a troop of its own headed the same way, it waits for it.
+    // Two such troops can block each other, so the wait is bounded.
+    bool waiting = blocked && hit >= 0 && entities.owners[hit] == entities.owners[i] && entities.moving[hit] == MoveState::Walking &&
+      entities.orderXs[hit] == goal.x && entities.orderYs[hit] == goal.y;
+    if (nextX != x || nextY != y) {
+      entities.waitTicks[i] = 0;
+    } else if (waiting && ++entities.waitTicks[i] > MAX_WAIT_SECONDS * tickRate) {
+      waiting = false;
     }
 
-    // Log the updated midpoint after each move
-    log("Troop " + std::to_string(troop->id) + " (Client: " + std::to_string(playerSocket) + ") moved to (" + std::to_string(troop->midpoint[0]) + ", " + std::to_string(troop->midpoint[1]) + ")");
+    if (nextX != x || nextY != y) {
+      // Only troops move, so they live on the unit layer. Clearing the old
+      // position and stamping the new one is recomposited in one pass, so
+      // only the tiles that actually changed color are broadcast.
+      gameState.board.eraseCircle(BoardLayer::Units, x, y, entities.radii[i], StampMode::Filled);
+      gameState.board.drawCircle(BoardLayer::Units, nextX, nextY, entities.radii[i], entities.colors[i], StampMode::Filled);
+      entities.move(entities.handleAt(i), nextX, nextY);
+    }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(50)); // Adjust the delay as needed
+    if (waiting) {
+      continue;
+    } else if (blocked) {
+      log("Troop " + std::to_string(entities.ids[i]) + " (Client: " + std::to_string(entities.owners[i]) + ") blocked at (" + std::to_string(nextX) + ", " + std::to_string(nextY) + ")");
+      entities.moving[i] = MoveState::Idle;
+      gameState.routes.erase(found);
+    } else if (arrived) {
+      log("Troop " + std::to_string(entities.ids[i]) + " (Client: " + std::to_string(entities.owners[i]) + ") arrived at (" + std::to_string(nextX) + ", " + std::to_string(nextY) + ")");
+      entities.moving[i] = MoveState::Idle;
+      gameState.routes.erase(found);
+    }
   }
 }
 
 
 // Functionality for most of the networking stuff below here
 
+// The player's founded city closest to coords, nullptr if there is none
+City* findNearestCity(PlayerState& player, const std::vector<int>& coords) 
+{
+  HandleList nearest;
+  gameState.entities->nearest(coords[0], coords[1], 1, ownedBy(static_cast<EntityOwner>(player.socket), EntityType::City), nearest);
+  for (auto& city : player.cities) {
+    if (!nearest.empty() && city.handle == nearest[0]) return &city;
+  }
+  return nullptr;
+}
+
 // Function to handle messages from a client
 void handlePlayerMessage(SOCKET clientSocket, const std::string& message) 
 {
@@ -1001,30 +933,38 @@ void handlePlayerMessage(SOCKET clientSocket, const std::string& message)
 
   std::vector<int> coords = { x, y };
 
+  // Wipes the match for every player, so only when the server allows it
   if (x == 1000 && y == 1000) {
-    initializeGameState();
+    if (matchResetAllowed) {
+      startNewMatch();
+    } else {
+      log("Ignoring match reset from client " + std::to_string(clientSocket) + ", start the server with --match-reset on to allow it.");
+    }
     return;
   }
 
   if (player.phase == 0) {
     log("Player has no cities.");
 
-    // Check if the new city is within 100 tiles of any existing city
+    // Check if the new city is within 200 tiles of any existing city
     bool tooClose = false;
-    for (const auto& playerPair : gameState.playerStates) {
-      const PlayerState& otherPlayer = playerPair.second;
-      for (const auto& city : otherPlayer.cities) {
-        if (!city.midpoint.empty()) {
-          int dx = coords[0] - city.midpoint[0];
-          int dy = coords[1] - city.midpoint[1];
-          int distanceSquared = dx * dx + dy * dy;
-          if (distanceSquared < 200 * 200) {
-              tooClose = true;
-              break;
-          }
+    InfluenceLookup canFound = gameState.influence.canFoundCity(coords[0], coords[1]);
+    if (canFound == InfluenceLookup::Unsure) {
+      // Near a spacing boundary, measure against the cities themselves
+      HandleList nearbyCities;
+      gameState.entities->queryRadius(coords[0], coords[1], CITY_SPACING, ofType(EntityType::City), nearbyCities);
+      // Exactly 200 away is still allowed
+      for (EntityHandle city : nearbyCities) {
+        std::vector<int> midpoint = midpointOf(city);
+        int dx = coords[0] - midpoint[0];
+        int dy = coords[1] - midpoint[1];
+        if (dx * dx + dy * dy < CITY_SPACING * CITY_SPACING) {
+          tooClose = true;
+          break;
         }
       }
-      if (tooClose) break;
+    } else {
+      tooClose = canFound == InfluenceLookup::No;
     }
 
     if (tooClose) {
@@ -1032,26 +972,30 @@ void handlePlayerMessage(SOCKET clientSocket, const std::string& message)
       return;
     }
 
-    if (insertCharacter(coords, 20, "yellow")) {
+    if (insertCharacter(coords, cityStats.size, cityStats.color, BoardLayer::Structures)) {
+      int cityId = generateUniqueId(); // Generate a unique ID for the city
       City newCity;
-      newCity.id = generateUniqueId(); // Generate a unique ID for the city
-      newCity.midpoint = { coords[0], coords[1] };
-      newCity.size = 20;
-      newCity.defense = 100;
-      newCity.attack = 10;
-      newCity.color = "yellow";
+      newCity.handle = gameState.entities->create(EntityType::City, static_cast<EntityOwner>(clientSocket), cityId, coords[0], coords[1], cityStats);
+      gameState.influence.cityChanged(*gameState.entities, coords[0], coords[1]);
+      pathService.structureAdded(coords[0], coords[1], cityStats.size);
       player.cities[0] = newCity;
       player.phase = 1;
       update_player_state(gameState, clientSocket, player);
+    } else {
+      log("Failed to insert city character.");
     }
     return;
   }
 
   if (characterType == "select") {
-    std::shared_ptr<Troop> nearestTroop = findNearestTroop(player, coords);
-    if (nearestTroop && isWithinRadius(coords, nearestTroop->midpoint, nearestTroop->size)) {
+    EntityHandle nearestTroop = findNearestTroop(player, coords);
+    std::vector<int> troopMidpoint;
+    int troopSize = 0;
+    troopMidpoint = midpointOf(nearestTroop);
+    if (!troopMidpoint.empty()) troopSize = gameState.entities->radii[gameState.entities->indexOf(nearestTroop)];
+    if (!troopMidpoint.empty() && isWithinRadius(coords, troopMidpoint, troopSize)) {
       player.selectedTroop = nearestTroop;
-      log("Troop selected at (" + std::to_string(nearestTroop->midpoint[0]) + ", " + std::to_string(nearestTroop->midpoint[1]) + ")");
+      log("Troop selected at (" + std::to_string(troopMidpoint[0]) + ", " + std::to_string(troopMidpoint[1]) + ")");
     } else {
       log("No troop found at the selected position.");
     }
@@ -1059,20 +1003,55 @@ void handlePlayerMessage(SOCKET clientSocket, const std::string& message)
     return;
   }
 
-  if (characterType == "move" && player.selectedTroop) {
-    std::future<void> moveFuture = std::async(std::launch::async, moveTroopToPosition, clientSocket, player.selectedTroop, coords);
-    player.selectedTroop = nullptr; // Deselect the troop after starting the movement
+  if (characterType == "move" && player.selectedTroop != EntityHandle()) {
+    // The troop waits for its route off the tick, then the movement
+    // phase walks it there
+    EntityStore& entities = *gameState.entities;
+    int index = entities.indexOf(player.selectedTroop);
+    if (index >= 0) {
+      entities.orderXs[index] = coords[0];
+      entities.orderYs[index] = coords[1];
+      entities.moving[index] = MoveState::Pathing;
+      gameState.routes.erase(entities.ids[index]);
+      pathService.request(player.selectedTroop, { entities.xs[index], entities.ys[index] }, { coords[0], coords[1] });
+    } else {
+      log("Troop no longer exists in the game state.");
+    }
+    player.selectedTroop = EntityHandle(); // Deselect the troop after giving the order
     update_player_state(gameState, clientSocket, player);
     return;
   }
 
+  if (characterType == "rally") {
+    // Every troop the player has heads there along one shared flow field
+    std::vector<EntityHandle> group;
+    EntityStore& entities = *gameState.entities;
+    for (const auto& city : player.cities) {
+      for (EntityHandle troop : city.troops) {
+        int index = entities.indexOf(troop);
+        if (index < 0) continue;
+        entities.orderXs[index] = coords[0];
+        entities.orderYs[index] = coords[1];
+        entities.moving[index] = MoveState::Pathing;
+        gameState.routes.erase(entities.ids[index]);
+        group.push_back(troop);
+      }
+    }
+    if (!group.empty()) pathService.requestGroup(group, { coords[0], coords[1] });
+    log("Rallying " + std::to_string(group.size()) + " troops to (" + std::to_string(coords[0]) + ", " + std::to_string(coords[1]) + ")");
+    return;
+  }
+
   // Check if the coordinates are within the radius of a city plus an additional 100 tiles
   bool withinCityRadius = false;
-  for (const auto& city : player.cities) {
-    if (isWithinRadius(coords, city.midpoint, city.size + 100)) {
-      withinCityRadius = true;
-      break;
-    }
+  EntityOwner owner = static_cast<EntityOwner>(clientSocket);
+  InfluenceLookup inTerritory = gameState.influence.inTerritory(coords[0], coords[1], owner);
+  if (inTerritory == InfluenceLookup::Unsure) {
+    HandleList ownCities;
+    gameState.entities->queryRadius(coords[0], coords[1], cityStats.size + CITY_BUILD_RANGE, ownedBy(owner, EntityType::City), ownCities);
+    withinCityRadius = !ownCities.empty();
+  } else {
+    withinCityRadius = inTerritory == InfluenceLookup::Yes;
   }
 
   if (!withinCityRadius) {
@@ -1082,19 +1061,12 @@ void handlePlayerMessage(SOCKET clientSocket, const std::string& message)
 
   // Existing code for handling other character types (coin, troop, building)
   if (characterType == "coin") {
-    City* nearestCity = nullptr;
-    int minDistance = std::numeric_limits<int>::max();
-    for (auto& city : player.cities) {
-      if (city.midpoint.empty()) continue; // Skip uninitialized cities
-      int dx = coords[0] - city.midpoint[0];
-      int dy = coords[1] - city.midpoint[1];
-      int distance = dx * dx + dy * dy;
-      if (distance < minDistance) {
-        minDistance = distance;
-        nearestCity = &city;
-      }
+    City* nearestCity = findNearestCity(player, coords);
+    std::vector<int> cityMidpoint;
+    if (nearestCity) {
+      cityMidpoint = midpointOf(nearestCity->handle);
     }
-    if (nearestCity && isWithinRadius(coords, nearestCity->midpoint, 20)) {
+    if (nearestCity && isWithinRadius(coords, cityMidpoint, cityStats.size)) {
       player.coins++;
       nearestCity->coins++;
       log(std::to_string(player.coins) + " coins collected. City now has " + std::to_string(nearestCity->coins) + " coins.");
@@ -1104,113 +1076,177 @@ void handlePlayerMessage(SOCKET clientSocket, const std::string& message)
       log("Not enough coins to create troop.");
       return;
     }
-    if (!insertCharacter(coords, troopMap["Barbarian"].size, troopMap["Barbarian"].color)) {
+    if (!insertCharacter(coords, troopMap["Barbarian"].size, troopMap["Barbarian"].color, BoardLayer::Units)) {
       log("Failed to insert troop character.");
       return;
     }
     player.coins -= troopMap["Barbarian"].cost;
     log("Troop created. Player now has " + std::to_string(player.coins) + " coins left.");
 
-    Troop newTroop = troopMap["Barbarian"];
-    newTroop.id = generateUniqueId(); // Assign a unique ID to the new troop
-    newTroop.midpoint = { coords[0], coords[1] };
-    City* nearestCity = nullptr;
-    int minDistance = std::numeric_limits<int>::max();
-    for (auto& city : player.cities) {
-      if (city.midpoint.empty()) continue; // Skip uninitialized cities
-      int dx = coords[0] - city.midpoint[0];
-      int dy = coords[1] - city.midpoint[1];
-      int distance = dx * dx + dy * dy;
-      if (distance < minDistance) {
-        minDistance = distance;
-        nearestCity = &city;
-      }
-    }
+    int troopId = generateUniqueId(); // Assign a unique ID to the new troop
+    City* nearestCity = findNearestCity(player, coords);
     if (nearestCity) {
-      nearestCity->troops.push_back(newTroop);
+      nearestCity->troops.push_back(gameState.entities->create(EntityType::Troop, static_cast<EntityOwner>(clientSocket), troopId, coords[0], coords[1], troopMap["Barbarian"]));
     }
   } else if (characterType == "building") {
     if (player.coins < buildingMap["coinFarm"].cost) {
       log("Not enough coins to create building.");
       return;
     }
-    if (!insertCharacter(coords, buildingMap["coinFarm"].size, buildingMap["coinFarm"].color)) {
+    if (!insertCharacter(coords, buildingMap["coinFarm"].size, buildingMap["coinFarm"].color, BoardLayer::Structures)) {
       log("Failed to insert building character.");
       return;
     }
     player.coins -= buildingMap["coinFarm"].cost;
     log("Building created. Player now has " + std::to_string(player.coins) + " coins left.");
 
-    Building newBuilding = buildingMap["coinFarm"];
-    newBuilding.id = generateUniqueId(); // Assign a unique ID to the new building
-    newBuilding.midpoint = { coords[0], coords[1] };
-    City* nearestCity = nullptr;
-    int minDistance = std::numeric_limits<int>::max();
-    for (auto& city : player.cities) {
-      if (city.midpoint.empty()) continue; // Skip uninitialized cities
-        int dx = coords[0] - city.midpoint[0];
-        int dy = coords[1] - city.midpoint[1];
-        int distance = dx * dx + dy * dy;
-        if (distance < minDistance) {
-          minDistance = distance;
-          nearestCity = &city;
-      }
-    }
+    int buildingId = generateUniqueId(); // Assign a unique ID to the new building
+    City* nearestCity = findNearestCity(player, coords);
     if (nearestCity) {
-      nearestCity->buildings.push_back(newBuilding);
+      nearestCity->buildings.push_back(gameState.entities->create(EntityType::Building, static_cast<EntityOwner>(clientSocket), buildingId, coords[0], coords[1], buildingMap["coinFarm"]));
+      pathService.structureAdded(coords[0], coords[1], buildingMap["coinFarm"].size);
     }
   }
   update_player_state(gameState, clientSocket, player);
   sendPlayerStateDeltaToClient(player);
 }
 
-// Threaded client handling function
-void gameLogic(SOCKET clientSocket) 
+// Queues work for the simulation thread, from any thread
+void queueCommand(CommandType type, SOCKET clientSocket, std::string text, bool binary, std::shared_ptr<ClientOutbox> outbox)
 {
-  char buffer[512];
-  int bytesReceived;
+  Command command;
+  command.type = type;
+  command.client = static_cast<uint64_t>(clientSocket);
+  command.binary = binary;
+  command.text = std::move(text);
+  command.outbox = std::move(outbox);
+  commandQueue.push(std::move(command));
+}
+
+// Input phase of the board tick. Applies everything the network threads
+// queued since the last tick, oldest first, so a client's messages take
+// effect in the order it sent them.
+void applyCommands()
+{
+  Command command;
+  while (commandQueue.pop(command)) {
+    SOCKET clientSocket = static_cast<SOCKET>(command.client);
+    switch (command.type) {
+    case CommandType::Join:
+      joinPlayer(clientSocket, command.binary, std::move(command.outbox));
+      break;
+    case CommandType::Message:
+      handlePlayerMessage(clientSocket, command.text);
+      break;
+    case CommandType::Leave:
+      leavePlayer(clientSocket);
+      break;
+    }
+  }
+}
+
+// A client finished its handshake. It gets the board and a fresh player
+// state, and every broadcast from here on.
+void joinPlayer(SOCKET clientSocket, bool binary, std::shared_ptr<ClientOutbox> outbox)
+{
+  clients[clientSocket] = std::move(outbox);
+
+  // Send initial game state, the cached keyframe is shared by every joining client
+  std::shared_ptr<const std::string> frame;
+  gameState.board.composite();
+  if (binary) {
+    binaryClients.insert(clientSocket);
+    frame = gameState.binaryKeyframe.frame(gameState.board.output());
+  } else {
+    frame = gameState.textKeyframe.frame(gameState.board.output());
+  }
+  queueFrame(clientSocket, std::move(frame));
+  log("Initial game state queued for client.");
 
   // Initialize player state
   PlayerState player_state;
   player_state.socket = clientSocket;
-  player_state.coins = 1000; // Example initial state
+  player_state.coins = STARTING_COINS;
   player_state.phase = 0;
 
   // Store the initial state in the GameState structure
   update_player_state(gameState, clientSocket, player_state);
 
   sendPlayerStateDeltaToClient(player_state);
+}
+
+// A client disconnected. Its network thread closes the socket once the
+// client's sender has stopped, so nothing is written to it, or to a new
+// client given the same socket, after it is gone.
+void leavePlayer(SOCKET clientSocket)
+{
+  clients.erase(clientSocket);
+  binaryClients.erase(clientSocket);
+}
+
+// Sender thread of one client. Sends queued frames in order until the
+// outbox closes or the connection fails; shutting the socket down then
+// wakes the receiving thread, which queues the leave.
+void sendFrames(SOCKET clientSocket, ClientOutbox& outbox) 
+{
+  while (std::shared_ptr<const std::string> frame = outbox.pop()) {
+    size_t sent = 0;
+    while (sent < frame->size()) {
+      // A peer that went away is an error here, not a SIGPIPE that ends the server
+      int result = send(clientSocket, frame->c_str() + sent, static_cast<int>(frame->size() - sent), MSG_NOSIGNAL);
+      if (result == SOCKET_ERROR) {
+        log("Failed to send to client: " + std::to_string(WSAGetLastError()));
+        outbox.close();
+        break;
+      }
+      sent += result;
+    }
+  }
+  shutdown(clientSocket, SHUT_RDWR);
+}
+
+// Threaded client handling function. Only reads from the client, what it
+// sends is queued for the simulation thread. Owns the socket and closes it
+// after the leave, once the sender has stopped.
+void gameLogic(SOCKET clientSocket, bool binary) 
+{
+  std::shared_ptr<ClientOutbox> outbox = std::make_shared<ClientOutbox>(MAX_OUTBOX_BYTES);
+  std::thread sender(sendFrames, clientSocket, std::ref(*outbox));
+  // The simulation thread sends the board and adds the client to the game
+  queueCommand(CommandType::Join, clientSocket, std::string(), binary, outbox);
+
+  char buffer[512];
+  int bytesReceived;
 
   while ((bytesReceived = recv(clientSocket, buffer, sizeof(buffer), 0)) > 0) {
     std::string message(buffer, bytesReceived);
     std::string decodedMessage = decodeWebSocketFrame(message);  // Decoding WebSocket frame
     log("Decoded message: " + decodedMessage);
-
-    // Submit the task to the thread pool
-    clientMessageThreadPool.enqueue([clientSocket, decodedMessage] {
-      handlePlayerMessage(clientSocket, decodedMessage);
-      });
+    queueCommand(CommandType::Message, clientSocket, std::move(decodedMessage));
   }
+  queueCommand(CommandType::Leave, clientSocket);
+  outbox->close();
+  sender.join();
   closesocket(clientSocket);
-  {
-    std::scoped_lock<std::mutex> lock(gameState.stateMutex);
-    clients.erase(clientSocket);
-  }
   log("Client disconnected.");
 }
 
-// Handle WebSocket handshake
-void handleWebSocketHandshake(SOCKET clientSocket, const std::string& request) 
+// Handle WebSocket handshake, true when the client asked for the binary protocol
+bool handleWebSocketHandshake(SOCKET clientSocket, const std::string& request) 
 {
   std::istringstream requestStream(request);
   std::string line;
   std::string webSocketKey;
+  bool wantsBinary = false;
 
   while (std::getline(requestStream, line) && line != "\r") {
     if (line.find("Sec-WebSocket-Key") != std::string::npos) {
       webSocketKey = line.substr(line.find(":") + 2);
       webSocketKey = webSocketKey.substr(0, webSocketKey.length() - 1);
     }
+    if (line.find("Sec-WebSocket-Protocol") != std::string::npos && line.find(BINARY_SUBPROTOCOL) != std::string::npos) {
+      wantsBinary = true;
+    }
   }
 
   std::string acceptKey = generateWebSocketAcceptKey(webSocketKey);
@@ -1218,22 +1254,17 @@ void handleWebSocketHandshake(SOCKET clientSocket, const std::string& request)
   responseStream << "HTTP/1.1 101 Switching Protocols\r\n";
   responseStream << "Upgrade: websocket\r\n";
   responseStream << "Connection: Upgrade\r\n";
-  responseStream << "Sec-WebSocket-Accept: " << acceptKey << "\r\n\r\n";
+  responseStream << "Sec-WebSocket-Accept: " << acceptKey << "\r\n";
+  if (wantsBinary) {
+    responseStream << "Sec-WebSocket-Protocol: " << BINARY_SUBPROTOCOL << "\r\n";
+  }
+  responseStream << "\r\n";
   std::string response = responseStream.str();
 
   send(clientSocket, response.c_str(), static_cast<int>(response.size()), 0);
 
   log("Handshake response sent: " + response);
-
-  // Send initial game state after handshake
-  std::string gameStateStr = serializeGameStateToString();
-  std::string frame = encodeWebSocketFrame(gameStateStr);
-  int sendResult = send(clientSocket, frame.c_str(), static_cast<int>(frame.size()), 0);
-  if (sendResult == SOCKET_ERROR) {
-    log("Failed to send initial state to client: " + std::to_string(WSAGetLastError()));
-  } else {
-    log("Initial game state sent to client.");
-  }
+  return wantsBinary;
 }
 
 // Accept new client connections
@@ -1252,20 +1283,15 @@ void acceptPlayer(SOCKET serverSocket)
     // Acquire a slot in the semaphore
     userSemaphore.acquire();
 
-    {
-      std::scoped_lock<std::mutex> lock(gameState.stateMutex);
-      clients[clientSocket] = clientAddr; // This is where we are storing our clients
-    }
-
     log("Client connected.");
 
     char buffer[1024];
     int bytesReceived = recv(clientSocket, buffer, sizeof(buffer), 0);
     if (bytesReceived > 0) {
       std::string request(buffer, bytesReceived);
-      handleWebSocketHandshake(clientSocket, request);
-      std::thread([clientSocket] {
-        gameLogic(clientSocket);
+      bool binary = handleWebSocketHandshake(clientSocket, request);
+      std::thread([clientSocket, binary] {
+        gameLogic(clientSocket, binary);
         // Release the semaphore slot when the game logic is done
         userSemaphore.release();
         }).detach();
@@ -1273,6 +1299,7 @@ void acceptPlayer(SOCKET serverSocket)
     else {
       log("Failed to receive handshake request: " + std::to_string(WSAGetLastError()));
       // Release the semaphore slot if handshake fails
+      closesocket(clientSocket);
       userSemaphore.release();
     }
   }
@@ -1285,8 +1312,6 @@ void updateCoinCounts()
   auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - gameState.lastUpdate);
 
   if (elapsed.count() >= 1) {
-    std::scoped_lock<std::mutex> lock(gameState.stateMutex);
-
     bool buildingsToSend = false;
     for (auto& playerPair : gameState.playerStates) {
       PlayerState& player = playerPair.second;
@@ -1294,10 +1319,12 @@ void updateCoinCounts()
           if (!city.buildings.empty()) {
             buildingsToSend = true;
           }
-        for (auto& building : city.buildings) {
-          //log("Adding " + std::to_string(building.coins) + " coins to city " + std::to_string(city.id));
-          city.coins += building.coins;
-          player.coins += building.coins;
+        for (EntityHandle building : city.buildings) {
+          int index = gameState.entities->indexOf(building);
+          if (index < 0) continue;
+          int coins = static_cast<const Building*>(gameState.entities->kinds[index])->coins;
+          city.coins += coins;
+          player.coins += coins;
         }
       }
       // Send the updated player state to the client
@@ -1308,55 +1335,35 @@ void updateCoinCounts()
   }
 }
 
-// This is the more global game loop running in the background, currently facing race condition problems
+// The global game loop, ticking at a fixed rate. This is the only thread
+// that touches the game state; player input is queued by the client
+// threads and applied in the input phase.
 void boardLoop() 
 {
-  while (true) {
-    clearCollidingEntities(); // Clear previous collisions
-
-    bool hasEntitiesToProcess = false;
-
-    {
-      std::scoped_lock<std::mutex> lock(gameState.stateMutex);
-      for (auto& playerPair : gameState.playerStates) {
-        PlayerState& player = playerPair.second;
-        for (auto& city : player.cities) {
-          if (!city.collidingEntities.empty()) {
-            hasEntitiesToProcess = true;
-            break;
-          }
-          for (auto& troop : city.troops) {
-            if (!troop.collidingEntities.empty()) {
-              hasEntitiesToProcess = true;
-              break;
-            }
-          }
-          for (auto& building : city.buildings) {
-            if (!building.collidingEntities.empty()) {
-              hasEntitiesToProcess = true;
-              break;
-            }
-          }
-        }
-        if (hasEntitiesToProcess) break;
-      }
-    }
-
-    if (hasEntitiesToProcess) {
-      handleTroopCollisions();
-    }
-    //std::thread(updateCoinCounts).detach();
-    subtaskThreadPool.enqueue(updateCoinCounts);
-    sendGameStateDeltasToClients();
-    std::this_thread::sleep_for(std::chrono::milliseconds(16)); // Add a delay to avoid busy-waiting
-  }
+  TickScheduler scheduler(tickRate, MAX_CATCH_UP_STEPS);
+  scheduler.setPhase(TickPhase::Input, applyCommands);
+  scheduler.setPhase(TickPhase::Movement, advanceMovement);
+  scheduler.setPhase(TickPhase::Combat, [] {
+    acquireTargets();
+    resolveCombat();
+  });
+  scheduler.setPhase(TickPhase::Economy, updateCoinCounts);
+  scheduler.setPhase(TickPhase::Broadcast, sendGameStateDeltasToClients);
+  // Logged with the tick stats rather than per tick, so logging stays off the broadcast
+  scheduler.setReport([] {
+    const DirtyStats& stats = gameState.board.output().stats();
+    return "Broadcast " + std::to_string(stats.emitted) + " tiles, " + std::to_string(stats.coalesced) + " of " + std::to_string(stats.writes) + " writes coalesced. Combat: " +
+      std::to_string(combatStats.attacks) + " attacks, " + std::to_string(combatStats.destroyed) + " entities destroyed.";
+  });
+  log("Ticking at " + std::to_string(tickRate) + " Hz.");
+  scheduler.run(TICK_REPORT_SECONDS);
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+  parseCommandLine(argc, argv);
   initializeMaps();
-  int threadsUsed = clientMessageCount + clientSubtaskCount + leftoverThreadCount;
-  log("Allocating " + std::to_string(threadsUsed) + " of the CPUs " + std::to_string(std::thread::hardware_concurrency()) + " Available Concurrent Threads.");
+  log("Running the simulation and " + std::to_string(pathWorkerCount) + " path workers on " + std::to_string(std::thread::hardware_concurrency()) + " available concurrent threads.");
 
   // NETWORK CONFIG
 #ifdef _WIN32
@@ -1400,7 +1407,14 @@ int main()
   }
 
   log("Listening on port 9001.");
+  gameState.board.output().setDeltaMode(deltaMode);
   initializeGameState();
+  log("Map is " + std::string(mapGeometry.name) + ", " + std::to_string(mapGeometry.pixelWidth) + "x" + std::to_string(mapGeometry.pixelHeight) + " pixels.");
+  log("World is " + std::to_string(gameState.board.cols()) + "x" + std::to_string(gameState.board.rows()) + " tiles in " + std::to_string(gameState.board.output().chunkCols() * gameState.board.output().chunkRows()) + " chunks of " + std::to_string(CHUNK_SIZE) + "x" + std::to_string(CHUNK_SIZE) + ".");
+  if (deltaMode == DeltaMode::FrameDiff) {
+    log("Board deltas come from frame diffs using the " + std::string(frameDiffKernelName()) + " kernel.");
+  }
+  log("Circle tests use the " + std::string(circleKernelName()) + " kernel.");
 
   std::thread acceptThread([serverSocket]() {
     acceptPlayer(serverSocket);
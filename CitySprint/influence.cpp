@@ -0,0 +1,117 @@
+#include "influence.h"
+
+#include <algorithm>
+
+InfluenceMap::InfluenceMap() : width(0), height(0), cellSize(1), cellsWide(0), cellsHigh(0), foundingDistance(0), buildingRange(0) {}
+
+void InfluenceMap::resize(int cols, int rows, int size, int founding, int building) {
+  width = std::max(cols, 1);
+  height = std::max(rows, 1);
+  cellSize = std::max(size, 1);
+  cellsWide = (width + cellSize - 1) / cellSize;
+  cellsHigh = (height + cellSize - 1) / cellSize;
+  foundingDistance = founding;
+  buildingRange = building;
+  cells.assign(static_cast<size_t>(cellsWide) * cellsHigh, { 0, InfluenceBand::Wild, false, false });
+}
+
+void InfluenceMap::rebuild(const EntityStore& entities) {
+  refresh(entities, 0, 0, cellsWide - 1, cellsHigh - 1);
+}
+
+void InfluenceMap::cityChanged(const EntityStore& entities, int x, int y) {
+  int reach = std::max(foundingDistance, buildingRange);
+  int cx0 = std::max((x - reach) / cellSize, 0);
+  int cy0 = std::max((y - reach) / cellSize, 0);
+  int cx1 = std::min((x + reach) / cellSize, cellsWide - 1);
+  int cy1 = std::min((y + reach) / cellSize, cellsHigh - 1);
+  refresh(entities, cx0, cy0, cx1, cy1);
+}
+
+// Squared distances from a city to the nearest and farthest tile of a cell
+static void distanceRange(int x, int y, int x0, int y0, int x1, int y1, int64_t& nearest, int64_t& farthest)
+{
+  int64_t nearX = std::min(std::max(x, x0), x1) - x;
+  int64_t nearY = std::min(std::max(y, y0), y1) - y;
+  int64_t farX = std::max(std::abs(x0 - x), std::abs(x1 - x));
+  int64_t farY = std::max(std::abs(y0 - y), std::abs(y1 - y));
+  nearest = nearX * nearX + nearY * nearY;
+  farthest = farX * farX + farY * farY;
+}
+
+void InfluenceMap::refresh(const EntityStore& entities, int cx0, int cy0, int cx1, int cy1) {
+  if (cells.empty() || cx0 > cx1 || cy0 > cy1) return;
+
+  // Every city that can reach the region, found once for all of its cells
+  int reach = std::max(foundingDistance, buildingRange);
+  int left = cx0 * cellSize;
+  int top = cy0 * cellSize;
+  int right = std::min((cx1 + 1) * cellSize, width) - 1;
+  int bottom = std::min((cy1 + 1) * cellSize, height) - 1;
+  int halfWidth = (right - left + 1) / 2 + 1;
+  int halfHeight = (bottom - top + 1) / 2 + 1;
+  HandleList cities;
+  entities.queryRadius((left + right) / 2, (top + bottom) / 2, reach + halfWidth + halfHeight, ofType(EntityType::City), cities);
+
+  int64_t founding = static_cast<int64_t>(foundingDistance) * foundingDistance;
+  int64_t building = static_cast<int64_t>(buildingRange) * buildingRange;
+  for (int cy = cy0; cy <= cy1; cy++) {
+    int y0 = cy * cellSize;
+    int y1 = std::min(y0 + cellSize, height) - 1;
+    for (int cx = cx0; cx <= cx1; cx++) {
+      int x0 = cx * cellSize;
+      int x1 = std::min(x0 + cellSize, width) - 1;
+
+      bool blocked = false;      // Some city is closer than foundingDistance to every tile
+      bool foundingEdge = false;
+      bool claimed = false;      // Some city is within buildingRange of every tile
+      bool buildingEdge = false;
+      EntityOwner owner = 0;
+      bool mixedOwners = false;
+      for (EntityHandle handle : cities) {
+        int index = entities.indexOf(handle);
+        int64_t nearest;
+        int64_t farthest;
+        distanceRange(entities.xs[index], entities.ys[index], x0, y0, x1, y1, nearest, farthest);
+
+        if (farthest < founding) {
+          blocked = true;
+        } else if (nearest < founding) {
+          foundingEdge = true;
+        }
+
+        if (nearest > building) continue;
+        if ((claimed || buildingEdge) && owner != entities.owners[index]) mixedOwners = true;
+        owner = entities.owners[index];
+        if (farthest <= building) {
+          claimed = true;
+        } else {
+          buildingEdge = true;
+        }
+      }
+
+      InfluenceCell& cell = cells[cy * cellsWide + cx];
+      cell.owner = claimed ? owner : 0;
+      cell.band = claimed ? InfluenceBand::Territory : blocked || foundingEdge ? InfluenceBand::Border : InfluenceBand::Wild;
+      cell.foundingEdge = foundingEdge && !blocked;
+      cell.buildingEdge = mixedOwners || (buildingEdge && !claimed);
+    }
+  }
+}
+
+const InfluenceCell* InfluenceMap::cellAt(int x, int y) const {
+  if (cells.empty() || x < 0 || y < 0 || x >= width || y >= height) return nullptr;
+  return &cells[(y / cellSize) * cellsWide + x / cellSize];
+}
+
+InfluenceLookup InfluenceMap::canFoundCity(int x, int y) const {
+  const InfluenceCell* cell = cellAt(x, y);
+  if (!cell || cell->foundingEdge) return InfluenceLookup::Unsure;
+  return cell->band == InfluenceBand::Wild ? InfluenceLookup::Yes : InfluenceLookup::No;
+}
+
+InfluenceLookup InfluenceMap::inTerritory(int x, int y, EntityOwner owner) const {
+  const InfluenceCell* cell = cellAt(x, y);
+  if (!cell || cell->buildingEdge) return InfluenceLookup::Unsure;
+  return cell->band == InfluenceBand::Territory && cell->owner == owner ? InfluenceLookup::Yes : InfluenceLookup::No;
+}
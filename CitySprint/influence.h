@@ -0,0 +1,62 @@
+#ifndef INFLUENCE_H
+#define INFLUENCE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "entity_store.h"
+
+// How far a cell is from the cities around it
+enum class InfluenceBand : uint8_t {
+  Territory, // Within building range of its owner's cities, and of no one else's
+  Border,    // Too close to a city to found another, outside every building range
+  Wild       // Far enough from every city to found a new one
+};
+
+// One low resolution cell, covering cellSize x cellSize tiles
+struct InfluenceCell {
+  EntityOwner owner;
+  InfluenceBand band;
+  bool foundingEdge; // A founding distance boundary crosses the cell
+  bool buildingEdge; // A building range boundary or a second owner's range crosses the cell
+};
+
+// Answer from a single raster lookup. Unsure means the point lies in a
+// cell that straddles a boundary and needs an exact check.
+enum class InfluenceLookup : uint8_t { No, Yes, Unsure };
+
+// Coarse raster of city influence used to validate placement. A city may
+// only be founded at least foundingDistance from every other city (strictly
+// closer is refused), and troops and buildings only go within
+// buildingRange of one of the player's own cities (inclusive). Cells are
+// only recomputed around a city when it is founded or destroyed, so every
+// click is answered by one lookup except near a boundary.
+class InfluenceMap {
+public:
+  InfluenceMap();
+  void resize(int cols, int rows, int cellSize, int foundingDistance, int buildingRange);
+
+  // Recomputes every cell from the cities in entities
+  void rebuild(const EntityStore& entities);
+  // Recomputes the cells a city at (x, y) reaches, after it was founded or destroyed
+  void cityChanged(const EntityStore& entities, int x, int y);
+
+  InfluenceLookup canFoundCity(int x, int y) const;
+  InfluenceLookup inTerritory(int x, int y, EntityOwner owner) const;
+
+  const InfluenceCell* cellAt(int x, int y) const;
+
+private:
+  void refresh(const EntityStore& entities, int cx0, int cy0, int cx1, int cy1);
+
+  int width;
+  int height;
+  int cellSize;
+  int cellsWide;
+  int cellsHigh;
+  int foundingDistance;
+  int buildingRange;
+  std::vector<InfluenceCell> cells;
+};
+
+#endif // INFLUENCE_H
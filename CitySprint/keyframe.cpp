@@ -0,0 +1,76 @@
+#include "keyframe.h"
+#include "protocol.h"
+#include "utilities.h"
+
+#include <limits>
+
+// Version no chunk can have, forces the first encode
+const uint64_t UNENCODED_VERSION = std::numeric_limits<uint64_t>::max();
+
+Keyframe::Keyframe(KeyframeFormat format) : format(format), width(0), height(0), stale(true), paletteSize(0) {}
+
+void Keyframe::update(const Board& board) {
+  if (board.cols() != width || board.rows() != height) {
+    width = board.cols();
+    height = board.rows();
+    segments.assign(static_cast<size_t>(board.chunkCols()) * board.chunkRows(), "");
+    segmentVersions.assign(segments.size(), UNENCODED_VERSION);
+    stale = true;
+  }
+
+  for (int cy = 0; cy < board.chunkRows(); cy++) {
+    for (int cx = 0; cx < board.chunkCols(); cx++) {
+      int index = board.chunkIndex(cx, cy);
+      uint64_t version = board.chunkVersion(cx, cy);
+      if (segmentVersions[index] == version) continue;
+
+      if (format == KeyframeFormat::Binary) {
+        segments[index] = encodeChunkBinary(board, cx, cy);
+      } else {
+        segments[index] = serializeChunkToString(board, cx, cy);
+      }
+      segmentVersions[index] = version;
+      stale = true;
+    }
+  }
+}
+
+std::shared_ptr<const std::string> Keyframe::frame(const Board& board) {
+  update(board);
+  if (format == KeyframeFormat::Binary && ColorRegistry::getInstance().size() != paletteSize) {
+    stale = true;
+  }
+  if (stale) {
+    assemble(board);
+  }
+  return assembled;
+}
+
+void Keyframe::assemble(const Board& board) {
+  size_t total = 0;
+  for (const auto& segment : segments) {
+    total += segment.size();
+  }
+
+  std::string message;
+  if (format == KeyframeFormat::Binary) {
+    message = encodeKeyframeHeaderBinary(board);
+    message.reserve(message.size() + total);
+    for (const auto& segment : segments) {
+      message += segment;
+    }
+    paletteSize = ColorRegistry::getInstance().size();
+    std::string frames = encodeWebSocketFrame(encodePaletteBinary(), WS_OPCODE_BINARY);
+    frames += encodeWebSocketFrame(message, WS_OPCODE_BINARY);
+    assembled = std::make_shared<const std::string>(std::move(frames));
+  } else {
+    message.reserve(TEXT_BOARD_PREFIX.size() + total + TEXT_BOARD_SUFFIX.size());
+    message += TEXT_BOARD_PREFIX;
+    for (const auto& segment : segments) {
+      message += segment;
+    }
+    message += TEXT_BOARD_SUFFIX;
+    assembled = std::make_shared<const std::string>(encodeWebSocketFrame(message));
+  }
+  stale = false;
+}
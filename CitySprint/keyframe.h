@@ -0,0 +1,45 @@
+#ifndef KEYFRAME_H
+#define KEYFRAME_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "board.h"
+
+enum class KeyframeFormat {
+  Text,
+  Binary
+};
+
+// A ready-to-send WebSocket frame holding the whole board for new clients.
+// Each chunk is encoded separately and only re-encoded when its version
+// moves, so keeping the keyframe current costs work proportional to what
+// changed, and a join is a single send of the cached buffer. The binary
+// keyframe also carries the palette so the client can decode it at once.
+class Keyframe {
+public:
+  Keyframe(KeyframeFormat format);
+
+  // Re-encodes the chunks that changed since the last update
+  void update(const Board& board);
+
+  // Returns the framed keyframe, reassembling it only if something changed.
+  // Joining clients share the buffer, so it can be sent after unlocking.
+  std::shared_ptr<const std::string> frame(const Board& board);
+
+private:
+  void assemble(const Board& board);
+
+  KeyframeFormat format;
+  int width;
+  int height;
+  std::vector<std::string> segments;  // Encoded chunks, indexed like the board's chunks
+  std::vector<uint64_t> segmentVersions;
+  bool stale;
+  int paletteSize;
+  std::shared_ptr<const std::string> assembled;
+};
+
+#endif // KEYFRAME_H
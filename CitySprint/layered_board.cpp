@@ -0,0 +1,164 @@
+#include "layered_board.h"
+
+#include <algorithm>
+#include <cstring>
+
+// What an untouched tile holds on each layer
+static ColorIndex layerDefault(int layer)
+{
+  return layer == static_cast<int>(BoardLayer::Terrain) ? BACKGROUND_COLOR : TRANSPARENT_COLOR;
+}
+
+LayeredBoard::LayeredBoard() : shippedMap(ShippedMap::None), width(0), height(0), chunksWide(0), chunksHigh(0) {}
+
+void LayeredBoard::resize(int cols, int rows) {
+  if (SmallMap::matches(cols, rows)) shippedMap = ShippedMap::Small;
+  else if (StandardMap::matches(cols, rows)) shippedMap = ShippedMap::Standard;
+  else if (LargeMap::matches(cols, rows)) shippedMap = ShippedMap::Large;
+  else shippedMap = ShippedMap::None;
+  width = cols;
+  height = rows;
+  chunksWide = (cols + CHUNK_MASK) >> CHUNK_SHIFT;
+  chunksHigh = (rows + CHUNK_MASK) >> CHUNK_SHIFT;
+  layerChunks.clear();
+  layerChunks.resize(static_cast<size_t>(chunksWide) * chunksHigh);
+  composited.resize(cols, rows);
+  dirtyRegions.clear();
+}
+
+// Background terrain everywhere, nothing built, every tile resent
+void LayeredBoard::reset() {
+  for (auto& chunk : layerChunks) {
+    chunk.reset();
+  }
+  dirtyRegions.clear();
+  composited.reset();
+}
+
+LayerChunk* LayeredBoard::allocateChunk(int cx, int cy) {
+  std::unique_ptr<LayerChunk>& slot = layerChunks[cy * chunksWide + cx];
+  slot = std::make_unique<LayerChunk>();
+  for (int layer = 0; layer < LAYER_COUNT; layer++) {
+    std::memset(slot->tiles[layer], layerDefault(layer), CHUNK_AREA);
+  }
+  return slot.get();
+}
+
+// Calls visit with the GameBoard of the shipped map this board was sized
+// for, or with a RuntimeBoard for a custom size
+template <class Visit>
+void LayeredBoard::withGeometry(Visit visit) {
+  switch (shippedMap) {
+    case ShippedMap::Small: visit(SmallMap()); break;
+    case ShippedMap::Standard: visit(StandardMap()); break;
+    case ShippedMap::Large: visit(LargeMap()); break;
+    default: visit(RuntimeBoard(width, height)); break;
+  }
+}
+
+void LayeredBoard::set(BoardLayer layer, int x, int y, ColorIndex color) {
+  withGeometry([&](const auto& geometry) {
+    if (!geometry.inBounds(x, y)) return;
+    fillLayerSpan(geometry, layer, y, x, x, color);
+    markRegion(x, y, x, y);
+  });
+}
+
+void LayeredBoard::drawCircle(BoardLayer layer, int centerX, int centerY, int radius, ColorIndex color, StampMode mode) {
+  const CircleStamp& stamp = circleStamp(radius);
+  const std::vector<Span>& spans = mode == StampMode::Filled ? stamp.filled : stamp.outline;
+  withGeometry([&](const auto& geometry) {
+    for (const Span& span : spans) {
+      fillLayerSpan(geometry, layer, centerY + span.dy, centerX + span.x0, centerX + span.x1, color);
+    }
+  });
+  markRegion(centerX - radius, centerY - radius, centerX + radius, centerY + radius);
+}
+
+// Terrain is never transparent, so erasing it restores the background
+void LayeredBoard::eraseCircle(BoardLayer layer, int centerX, int centerY, int radius, StampMode mode) {
+  drawCircle(layer, centerX, centerY, radius, layerDefault(static_cast<int>(layer)), mode);
+}
+
+void LayeredBoard::composite() {
+  withGeometry([&](const auto& geometry) {
+    for (const Rect& region : dirtyRegions) {
+      compositeRegion(geometry, region);
+    }
+  });
+  dirtyRegions.clear();
+}
+
+// Clips the span once, then writes it chunk by chunk. Writing a layer's
+// default color into a chunk that was never allocated changes nothing.
+template <class Geometry>
+void LayeredBoard::fillLayerSpan(const Geometry& geometry, BoardLayer layer, int y, int x0, int x1, ColorIndex color) {
+  if (y < 0 || y >= geometry.rows()) return;
+  x0 = std::max(x0, 0);
+  x1 = std::min(x1, geometry.cols() - 1);
+  if (x0 > x1) return;
+
+  int layerIndex = static_cast<int>(layer);
+  int cy = y >> CHUNK_SHIFT;
+  int rowOffset = (y & CHUNK_MASK) << CHUNK_SHIFT;
+  for (int cx = x0 >> CHUNK_SHIFT; cx <= (x1 >> CHUNK_SHIFT); cx++) {
+    LayerChunk* chunk = layerChunks[geometry.chunkIndex(cx, cy)].get();
+    if (!chunk) {
+      if (color == layerDefault(layerIndex)) continue;
+      chunk = allocateChunk(cx, cy);
+    }
+    int start = std::max(x0, cx << CHUNK_SHIFT) & CHUNK_MASK;
+    int end = std::min(x1, (cx << CHUNK_SHIFT) + CHUNK_MASK) & CHUNK_MASK;
+    std::memset(chunk->tiles[layerIndex] + rowOffset + start, color, end - start + 1);
+  }
+}
+
+void LayeredBoard::markRegion(int x0, int y0, int x1, int y1) {
+  Rect region = { std::max(x0, 0), std::max(y0, 0), std::min(x1, width - 1), std::min(y1, height - 1) };
+  if (region.x0 > region.x1 || region.y0 > region.y1) return;
+  dirtyRegions.push_back(region);
+}
+
+// Topmost non-transparent layer wins; the output only changes where the result
+// differs. Each chunk row is resolved into a scratch row first, a branch-free
+// select over the three layers, and only then compared with what is shown.
+template <class Geometry>
+void LayeredBoard::compositeRegion(const Geometry& geometry, const Rect& region) {
+  ColorIndex resolved[CHUNK_SIZE];
+  for (int cy = region.y0 >> CHUNK_SHIFT; cy <= (region.y1 >> CHUNK_SHIFT); cy++) {
+    for (int cx = region.x0 >> CHUNK_SHIFT; cx <= (region.x1 >> CHUNK_SHIFT); cx++) {
+      const LayerChunk* chunk = layerChunks[geometry.chunkIndex(cx, cy)].get();
+      const ColorIndex* current = composited.chunkTiles(cx, cy);
+      if (!chunk && !current) continue; // Nothing drawn and nothing shown
+
+      int yStart = std::max(region.y0, cy << CHUNK_SHIFT);
+      int yEnd = std::min(region.y1, (cy << CHUNK_SHIFT) + CHUNK_MASK);
+      int start = std::max(region.x0, cx << CHUNK_SHIFT) & CHUNK_MASK;
+      int end = std::min(region.x1, (cx << CHUNK_SHIFT) + CHUNK_MASK) & CHUNK_MASK;
+      for (int y = yStart; y <= yEnd; y++) {
+        int rowOffset = (y & CHUNK_MASK) << CHUNK_SHIFT;
+        if (chunk) {
+          const ColorIndex* units = chunk->tiles[static_cast<int>(BoardLayer::Units)] + rowOffset;
+          const ColorIndex* structures = chunk->tiles[static_cast<int>(BoardLayer::Structures)] + rowOffset;
+          const ColorIndex* terrain = chunk->tiles[static_cast<int>(BoardLayer::Terrain)] + rowOffset;
+          for (int i = start; i <= end; i++) {
+            ColorIndex unit = units[i];
+            ColorIndex structure = structures[i];
+            ColorIndex ground = terrain[i];
+            ColorIndex color = unit != TRANSPARENT_COLOR ? unit : structure;
+            resolved[i] = color != TRANSPARENT_COLOR ? color : ground;
+          }
+        } else {
+          std::memset(resolved + start, BACKGROUND_COLOR, end - start + 1);
+        }
+        for (int i = start; i <= end; i++) {
+          ColorIndex shown = current ? current[rowOffset + i] : BACKGROUND_COLOR;
+          if (shown != resolved[i]) {
+            composited.set((cx << CHUNK_SHIFT) | i, y, resolved[i]);
+            current = composited.chunkTiles(cx, cy);
+          }
+        }
+      }
+    }
+  }
+}
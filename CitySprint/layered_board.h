@@ -0,0 +1,83 @@
+#ifndef LAYERED_BOARD_H
+#define LAYERED_BOARD_H
+
+#include <memory>
+#include <vector>
+
+#include "board.h"
+#include "game_board.h"
+#include "raster.h"
+
+// Layers from bottom to top, higher layers cover lower ones
+enum class BoardLayer {
+  Terrain,
+  Structures,
+  Units
+};
+
+const int LAYER_COUNT = 3;
+
+// Layer tiles for one chunk of the board, allocated on first write
+struct LayerChunk {
+  ColorIndex tiles[LAYER_COUNT][CHUNK_AREA];
+};
+
+// Inclusive tile rectangle
+struct Rect {
+  int x0;
+  int y0;
+  int x1;
+  int y1;
+};
+
+// Keeps terrain, structures and units in separate layers and composites
+// them into the Board that gets sent to clients. Erasing an entity only
+// clears its own layer, so whatever lies underneath shows through again.
+// The composite is recomputed only inside regions touched since the last
+// call, and only tiles whose visible color really changed are marked dirty.
+// Layers use the same chunk grid as the output board and are only allocated
+// where something has been drawn. On a shipped map size the span fill and
+// composite run instantiated for that GameBoard, so their bounds and chunk
+// stride are constants.
+class LayeredBoard {
+public:
+  LayeredBoard();
+  void resize(int cols, int rows);
+  void reset();
+
+  void set(BoardLayer layer, int x, int y, ColorIndex color);
+  void drawCircle(BoardLayer layer, int centerX, int centerY, int radius, ColorIndex color, StampMode mode);
+  void eraseCircle(BoardLayer layer, int centerX, int centerY, int radius, StampMode mode);
+  void composite();
+
+  int cols() const { return width; }
+  int rows() const { return height; }
+  bool inBounds(int x, int y) const { return x >= 0 && x < width && y >= 0 && y < height; }
+  Board& output() { return composited; }
+  const Board& output() const { return composited; }
+
+private:
+  enum class ShippedMap {
+    None,
+    Small,
+    Standard,
+    Large
+  };
+
+  LayerChunk* allocateChunk(int cx, int cy);
+  template <class Visit> void withGeometry(Visit visit);
+  template <class Geometry> void fillLayerSpan(const Geometry& geometry, BoardLayer layer, int y, int x0, int x1, ColorIndex color);
+  void markRegion(int x0, int y0, int x1, int y1);
+  template <class Geometry> void compositeRegion(const Geometry& geometry, const Rect& region);
+
+  ShippedMap shippedMap; // Which GameBoard the hot loops are instantiated for
+  int width;
+  int height;
+  int chunksWide;
+  int chunksHigh;
+  std::vector<std::unique_ptr<LayerChunk>> layerChunks;
+  std::vector<Rect> dirtyRegions;
+  Board composited;
+};
+
+#endif // LAYERED_BOARD_H
@@ -0,0 +1,113 @@
+#include "occupancy.h"
+#include "raster.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+  #include <intrin.h>
+#endif
+
+// Index of the lowest set bit, word must be non-zero
+static int lowestSetBit(uint64_t word)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, word);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(word);
+#endif
+}
+
+// Bits lo..hi of one word, both inclusive and within 0..63
+static uint64_t bitRange(int lo, int hi)
+{
+  return (~uint64_t(0) << lo) & (~uint64_t(0) >> (63 - hi));
+}
+
+OccupancyMap::OccupancyMap(std::pmr::memory_resource* resource) : width(0), height(0), wordsPerRow(0), occupied(resource), shared(resource), counts(resource) {}
+
+void OccupancyMap::resize(int cols, int rows) {
+  width = cols;
+  height = rows;
+  wordsPerRow = (cols + 63) >> 6;
+  occupied.assign(static_cast<size_t>(wordsPerRow) * rows, 0);
+  shared.assign(occupied.size(), 0);
+  counts.assign(static_cast<size_t>(cols) * rows, 0);
+}
+
+void OccupancyMap::clear() {
+  std::fill(occupied.begin(), occupied.end(), 0);
+  std::fill(shared.begin(), shared.end(), 0);
+  std::fill(counts.begin(), counts.end(), 0);
+}
+
+void OccupancyMap::stamp(int x, int y, int radius) {
+  addStamp(x, y, radius, 1);
+}
+
+void OccupancyMap::unstamp(int x, int y, int radius) {
+  addStamp(x, y, radius, -1);
+}
+
+// Counts change tile by tile; the bitmaps follow whenever a count crosses 1 or 2
+void OccupancyMap::addStamp(int x, int y, int radius, int delta) {
+  for (const Span& span : circleStamp(radius).filled) {
+    int row = y + span.dy;
+    if (row < 0 || row >= height) continue;
+    int x0 = std::max(x + span.x0, 0);
+    int x1 = std::min(x + span.x1, width - 1);
+    uint16_t* rowCounts = &counts[static_cast<size_t>(row) * width];
+    uint64_t* rowOccupied = &occupied[static_cast<size_t>(row) * wordsPerRow];
+    uint64_t* rowShared = &shared[static_cast<size_t>(row) * wordsPerRow];
+    for (int tx = x0; tx <= x1; tx++) {
+      if (delta < 0 && rowCounts[tx] == 0) continue; // Never stamped, nothing to take away
+      int count = rowCounts[tx] + delta;
+      rowCounts[tx] = static_cast<uint16_t>(count);
+      uint64_t bit = uint64_t(1) << (tx & 63);
+      if (count > 0) rowOccupied[tx >> 6] |= bit; else rowOccupied[tx >> 6] &= ~bit;
+      if (count > 1) rowShared[tx >> 6] |= bit; else rowShared[tx >> 6] &= ~bit;
+    }
+  }
+}
+
+bool OccupancyMap::overlaps(int x, int y, int radius, int ignoreX, int ignoreY, int ignoreRadius, int& hitX, int& hitY) const {
+  const CircleStamp& stamp = circleStamp(radius);
+  const CircleStamp* ignored = ignoreRadius >= 0 ? &circleStamp(ignoreRadius) : nullptr;
+
+  for (const Span& span : stamp.filled) {
+    int row = y + span.dy;
+    if (row < 0 || row >= height) continue;
+    int x0 = std::max(x + span.x0, 0);
+    int x1 = std::min(x + span.x1, width - 1);
+    if (x0 > x1) continue;
+
+    // The ignored stamp's span on this row, if it has one
+    int ignoreX0 = 1;
+    int ignoreX1 = 0;
+    if (ignored && row >= ignoreY - ignoreRadius && row <= ignoreY + ignoreRadius) {
+      const Span& ignoredSpan = ignored->filled[row - ignoreY + ignoreRadius];
+      ignoreX0 = ignoreX + ignoredSpan.x0;
+      ignoreX1 = ignoreX + ignoredSpan.x1;
+    }
+
+    const uint64_t* rowOccupied = &occupied[static_cast<size_t>(row) * wordsPerRow];
+    const uint64_t* rowShared = &shared[static_cast<size_t>(row) * wordsPerRow];
+    for (int word = x0 >> 6; word <= (x1 >> 6); word++) {
+      int base = word << 6;
+      uint64_t mask = bitRange(std::max(x0, base) - base, std::min(x1, base + 63) - base);
+      uint64_t own = 0;
+      int lo = std::max(ignoreX0, base);
+      int hi = std::min(ignoreX1, base + 63);
+      if (lo <= hi) own = bitRange(lo - base, hi - base);
+      // A tile only the ignored entity covers is free; a shared one never is
+      uint64_t conflict = mask & ((rowOccupied[word] & ~own) | rowShared[word]);
+      if (conflict) {
+        hitX = base + lowestSetBit(conflict);
+        hitY = row;
+        return true;
+      }
+    }
+  }
+  return false;
+}
@@ -0,0 +1,39 @@
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// One bit per board tile, 64 tiles per word, set wherever an entity's
+// filled circle stamp lies. A collision test ANDs the candidate circle's
+// row spans against the bitmap rows, so it costs one or two word
+// operations per row no matter how many entities there are. Tiles covered
+// by more than one entity are tracked in a second bitmap so one entity's
+// own footprint can be ignored exactly while it moves.
+class OccupancyMap {
+public:
+  explicit OccupancyMap(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+  void resize(int cols, int rows);
+  void clear();
+
+  void stamp(int x, int y, int radius);
+  void unstamp(int x, int y, int radius);
+
+  // True if the circle covers an occupied tile. When ignoreRadius is not
+  // negative, the stamp at (ignoreX, ignoreY) with that radius is treated
+  // as absent. The first conflicting tile is written to hitX and hitY.
+  bool overlaps(int x, int y, int radius, int ignoreX, int ignoreY, int ignoreRadius, int& hitX, int& hitY) const;
+
+private:
+  void addStamp(int x, int y, int radius, int delta);
+
+  int width;
+  int height;
+  int wordsPerRow;
+  std::pmr::vector<uint64_t> occupied; // At least one entity covers the tile
+  std::pmr::vector<uint64_t> shared;   // Two or more entities cover the tile
+  std::pmr::vector<uint16_t> counts;   // Entities covering each tile
+};
+
+#endif // OCCUPANCY_H
@@ -0,0 +1,49 @@
+#include "palette.h"
+#include "utilities.h"
+
+ColorRegistry::ColorRegistry() : count(0) {
+  // Register the colors the game already uses so their indices are stable
+  // across restarts; the background must come first.
+  for (const char* color : { "#696969", "white", "yellow", "red", "purple" }) {
+    indexOf(color);
+  }
+}
+
+ColorRegistry& ColorRegistry::getInstance() {
+  static ColorRegistry instance;
+  return instance;
+}
+
+ColorIndex ColorRegistry::indexOf(const std::string& color) {
+  std::scoped_lock<std::mutex> lock(registryMutex);
+  auto it = indices.find(color);
+  if (it != indices.end()) {
+    return it->second;
+  }
+  if (count >= TRANSPARENT_COLOR) {
+    log("Palette is full, drawing " + color + " as background.");
+    return BACKGROUND_COLOR;
+  }
+  ColorIndex index = static_cast<ColorIndex>(count);
+  names[index] = color;
+  indices[color] = index;
+  count++;
+  return index;
+}
+
+const std::string& ColorRegistry::nameOf(ColorIndex index) const {
+  return names[index];
+}
+
+int ColorRegistry::size() const {
+  std::scoped_lock<std::mutex> lock(registryMutex);
+  return count;
+}
+
+ColorIndex colorIndex(const std::string& color) {
+  return ColorRegistry::getInstance().indexOf(color);
+}
+
+const std::string& colorName(ColorIndex index) {
+  return ColorRegistry::getInstance().nameOf(index);
+}
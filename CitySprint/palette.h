@@ -0,0 +1,46 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Palette index stored in every board tile
+typedef uint8_t ColorIndex;
+
+const int MAX_PALETTE_SIZE = 256;
+
+// Index of the "#696969" background, always registered first
+const ColorIndex BACKGROUND_COLOR = 0;
+
+// Reserved index meaning "nothing drawn here" in the upper board layers
+const ColorIndex TRANSPARENT_COLOR = MAX_PALETTE_SIZE - 1;
+
+// Maps the color names used by the game ("#696969", "yellow", "red"...) to
+// compact palette indices so the board can store one byte per tile.
+// Indices are handed out once and never reassigned, so a name looked up by
+// index stays valid for the lifetime of the server.
+class ColorRegistry {
+public:
+  static ColorRegistry& getInstance();
+  ColorIndex indexOf(const std::string& color);
+  const std::string& nameOf(ColorIndex index) const;
+  int size() const;
+
+private:
+  ColorRegistry();
+  ColorRegistry(const ColorRegistry&) = delete;
+  ColorRegistry& operator=(const ColorRegistry&) = delete;
+
+  std::array<std::string, MAX_PALETTE_SIZE> names;
+  std::unordered_map<std::string, ColorIndex> indices;
+  int count;
+  mutable std::mutex registryMutex;
+};
+
+ColorIndex colorIndex(const std::string& color);
+const std::string& colorName(ColorIndex index);
+
+#endif // PALETTE_H
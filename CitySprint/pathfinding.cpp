@@ -0,0 +1,451 @@
+#include "pathfinding.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+
+// Move costs, straight and diagonal
+static const int STRAIGHT_COST = 10;
+static const int DIAGONAL_COST = 14;
+static const size_t MAX_CACHED_PATHS = 4096;
+static const size_t MAX_CACHED_FIELDS = 64; // Each is one byte per cell
+
+// The eight neighbours of a cell, straight ones first
+static const int NEIGHBOUR_XS[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+static const int NEIGHBOUR_YS[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+
+NavGrid::NavGrid() : width(0), height(0), cellSize(1), clearance(0), cellsWide(0), cellsHigh(0) {}
+
+void NavGrid::resize(int cols, int rows, int size, int margin) {
+  width = std::max(cols, 1);
+  height = std::max(rows, 1);
+  cellSize = std::max(size, 1);
+  clearance = margin;
+  cellsWide = (width + cellSize - 1) / cellSize;
+  cellsHigh = (height + cellSize - 1) / cellSize;
+  blockers.assign(static_cast<size_t>(cellsWide) * cellsHigh, 0);
+}
+
+void NavGrid::addObstacle(int x, int y, int radius) {
+  mark(x, y, radius, 1);
+}
+
+void NavGrid::removeObstacle(int x, int y, int radius) {
+  mark(x, y, radius, -1);
+}
+
+// Touches every cell with a tile within radius + clearance of (x, y)
+void NavGrid::mark(int x, int y, int radius, int delta) {
+  int reach = radius + clearance;
+  int cx0 = std::max((x - reach) / cellSize, 0);
+  int cy0 = std::max((y - reach) / cellSize, 0);
+  int cx1 = std::min((x + reach) / cellSize, cellsWide - 1);
+  int cy1 = std::min((y + reach) / cellSize, cellsHigh - 1);
+  int64_t limit = static_cast<int64_t>(reach) * reach;
+  for (int cy = cy0; cy <= cy1; cy++) {
+    int y0 = cy * cellSize;
+    int64_t dy = std::min(std::max(y, y0), std::min(y0 + cellSize, height) - 1) - y;
+    for (int cx = cx0; cx <= cx1; cx++) {
+      int x0 = cx * cellSize;
+      int64_t dx = std::min(std::max(x, x0), std::min(x0 + cellSize, width) - 1) - x;
+      if (dx * dx + dy * dy <= limit) {
+        blockers[cy * cellsWide + cx] += delta;
+      }
+    }
+  }
+}
+
+NavPoint NavGrid::cellOf(int x, int y) const {
+  return { std::min(std::max(x, 0), width - 1) / cellSize, std::min(std::max(y, 0), height - 1) / cellSize };
+}
+
+NavPoint NavGrid::centerOf(NavPoint cell) const {
+  return { std::min(cell.x * cellSize + cellSize / 2, width - 1), std::min(cell.y * cellSize + cellSize / 2, height - 1) };
+}
+
+static int octileDistance(int x0, int y0, int x1, int y1)
+{
+  int dx = std::abs(x1 - x0);
+  int dy = std::abs(y1 - y0);
+  return STRAIGHT_COST * std::max(dx, dy) + (DIAGONAL_COST - STRAIGHT_COST) * std::min(dx, dy);
+}
+
+static int sign(int value)
+{
+  return (value > 0) - (value < 0);
+}
+
+// State of one jump point search, sized to the grid
+struct JumpSearch {
+  const NavGrid& grid;
+  NavPoint goal;
+  std::vector<int> costs;   // Best known cost from start, INT_MAX if unseen
+  std::vector<int> parents; // Cell index the best path came from, -1 at start
+  std::vector<uint8_t> closed;
+
+  JumpSearch(const NavGrid& navGrid, NavPoint target) :
+    grid(navGrid), goal(target),
+    costs(static_cast<size_t>(navGrid.cols()) * navGrid.rows(), INT_MAX),
+    parents(costs.size(), -1),
+    closed(costs.size(), 0) {}
+
+  int index(int x, int y) const { return y * grid.cols() + x; }
+  bool open(int x, int y) const { return grid.walkable(x, y); }
+
+  // Walks from (x, y) in direction (dx, dy) until it reaches the goal or a
+  // cell with a forced neighbour, which is returned as a cell index, or
+  // runs into a wall, which returns -1
+  int jump(int x, int y, int dx, int dy) const {
+    while (true) {
+      if (!open(x, y)) return -1;
+      if (x == goal.x && y == goal.y) return index(x, y);
+      if (dx && dy) {
+        if (jump(x + dx, y, dx, 0) >= 0 || jump(x, y + dy, 0, dy) >= 0) return index(x, y);
+        // No squeezing between two blocked corners
+        if (!open(x + dx, y) || !open(x, y + dy)) return -1;
+      } else if (dx) {
+        if ((open(x, y - 1) && !open(x - dx, y - 1)) || (open(x, y + 1) && !open(x - dx, y + 1))) return index(x, y);
+      } else {
+        if ((open(x - 1, y) && !open(x - 1, y - dy)) || (open(x + 1, y) && !open(x + 1, y - dy))) return index(x, y);
+      }
+      x += dx;
+      y += dy;
+    }
+  }
+
+  // Directions worth searching from a cell, given the direction it was
+  // entered from, (0, 0) at the start
+  void directions(int x, int y, int dx, int dy, std::vector<NavPoint>& out) const {
+    out.clear();
+    if (dx == 0 && dy == 0) {
+      for (int ny = -1; ny <= 1; ny++) {
+        for (int nx = -1; nx <= 1; nx++) {
+          if (!nx && !ny) continue;
+          if (!open(x + nx, y + ny)) continue;
+          if (nx && ny && (!open(x + nx, y) || !open(x, y + ny))) continue;
+          out.push_back({ nx, ny });
+        }
+      }
+    } else if (dx && dy) {
+      bool vertical = open(x, y + dy);
+      bool horizontal = open(x + dx, y);
+      if (vertical) out.push_back({ 0, dy });
+      if (horizontal) out.push_back({ dx, 0 });
+      if (vertical && horizontal) out.push_back({ dx, dy });
+    } else if (dx) {
+      bool ahead = open(x + dx, y);
+      bool below = open(x, y + 1);
+      bool above = open(x, y - 1);
+      if (ahead) {
+        out.push_back({ dx, 0 });
+        if (below) out.push_back({ dx, 1 });
+        if (above) out.push_back({ dx, -1 });
+      }
+      if (below) out.push_back({ 0, 1 });
+      if (above) out.push_back({ 0, -1 });
+    } else {
+      bool ahead = open(x, y + dy);
+      bool right = open(x + 1, y);
+      bool left = open(x - 1, y);
+      if (ahead) {
+        out.push_back({ 0, dy });
+        if (right) out.push_back({ 1, dy });
+        if (left) out.push_back({ -1, dy });
+      }
+      if (right) out.push_back({ 1, 0 });
+      if (left) out.push_back({ -1, 0 });
+    }
+  }
+};
+
+PathStatus findPath(const NavGrid& grid, NavPoint start, NavPoint goal, std::chrono::microseconds budget, std::vector<NavPoint>& out)
+{
+  if (!grid.walkable(start.x, start.y) || !grid.walkable(goal.x, goal.y)) return PathStatus::NoPath;
+  if (start == goal) {
+    out.push_back(goal);
+    return PathStatus::Found;
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + budget;
+  JumpSearch search(grid, goal);
+  typedef std::pair<int, int> Entry; // Estimated total cost, cell index
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> frontier;
+  int startIndex = search.index(start.x, start.y);
+  int goalIndex = search.index(goal.x, goal.y);
+  search.costs[startIndex] = 0;
+  frontier.push({ octileDistance(start.x, start.y, goal.x, goal.y), startIndex });
+
+  std::vector<NavPoint> directions;
+  int expanded = 0;
+  while (!frontier.empty()) {
+    int current = frontier.top().second;
+    frontier.pop();
+    if (search.closed[current]) continue;
+    search.closed[current] = 1;
+    if (current == goalIndex) break;
+    if (++expanded % 64 == 0 && std::chrono::steady_clock::now() > deadline) return PathStatus::TimedOut;
+
+    int x = current % grid.cols();
+    int y = current / grid.cols();
+    int dx = 0;
+    int dy = 0;
+    if (search.parents[current] >= 0) {
+      dx = sign(x - search.parents[current] % grid.cols());
+      dy = sign(y - search.parents[current] / grid.cols());
+    }
+    search.directions(x, y, dx, dy, directions);
+    for (const NavPoint& direction : directions) {
+      int next = search.jump(x + direction.x, y + direction.y, direction.x, direction.y);
+      if (next < 0 || search.closed[next]) continue;
+      int nextX = next % grid.cols();
+      int nextY = next / grid.cols();
+      int cost = search.costs[current] + octileDistance(x, y, nextX, nextY);
+      if (cost < search.costs[next]) {
+        search.costs[next] = cost;
+        search.parents[next] = current;
+        frontier.push({ cost + octileDistance(nextX, nextY, goal.x, goal.y), next });
+      }
+    }
+  }
+  if (!search.closed[goalIndex]) return PathStatus::NoPath;
+
+  size_t first = out.size();
+  for (int cell = goalIndex; cell != startIndex; cell = search.parents[cell]) {
+    out.push_back({ cell % grid.cols(), cell / grid.cols() });
+  }
+  std::reverse(out.begin() + first, out.end());
+  return PathStatus::Found;
+}
+
+// Dijkstra outward from the goal. A unit may step from one cell to the
+// next under the same rules findPath uses, except that it may always step
+// into a blocked cell that leads on to the goal.
+FlowField::FlowField(std::shared_ptr<const NavGrid> navGrid, NavPoint goalCell) :
+  grid(std::move(navGrid)), goal(goalCell), directions(static_cast<size_t>(grid->cols()) * grid->rows(), -1) {
+  int cols = grid->cols();
+  int rows = grid->rows();
+  std::vector<int> costs(directions.size(), INT_MAX);
+  typedef std::pair<int, int> Entry; // Cost to the goal, cell index
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> frontier;
+  costs[goal.y * cols + goal.x] = 0;
+  frontier.push({ 0, goal.y * cols + goal.x });
+
+  while (!frontier.empty()) {
+    Entry entry = frontier.top();
+    frontier.pop();
+    int current = entry.second;
+    if (entry.first > costs[current]) continue;
+    int x = current % cols;
+    int y = current / cols;
+    bool blocked = !grid->walkable(x, y);
+    for (int k = 0; k < 8; k++) {
+      int nx = x + NEIGHBOUR_XS[k];
+      int ny = y + NEIGHBOUR_YS[k];
+      if (nx < 0 || ny < 0 || nx >= cols || ny >= rows) continue;
+      if (!blocked && !grid->walkable(nx, ny)) continue;
+      bool diagonal = NEIGHBOUR_XS[k] && NEIGHBOUR_YS[k];
+      if (diagonal && !blocked && (!grid->walkable(nx, y) || !grid->walkable(x, ny))) continue;
+      int next = ny * cols + nx;
+      int cost = entry.first + (diagonal ? DIAGONAL_COST : STRAIGHT_COST);
+      if (cost < costs[next]) {
+        costs[next] = cost;
+        directions[next] = static_cast<int8_t>(k); // Stepping back along k leads here
+        frontier.push({ cost, next });
+      }
+    }
+  }
+}
+
+NavPoint FlowField::next(int x, int y, NavPoint target) const {
+  NavPoint cell = grid->cellOf(x, y);
+  if (cell == goal) return target;
+  int direction = directions[cell.y * grid->cols() + cell.x];
+  if (direction < 0) {
+    int step = grid->tilesPerCell();
+    return { x + std::min(std::max(target.x - x, -step), step), y + std::min(std::max(target.y - y, -step), step) };
+  }
+  return grid->centerOf({ cell.x - NEIGHBOUR_XS[direction], cell.y - NEIGHBOUR_YS[direction] });
+}
+
+// First open cell on the line from one cell to another, false if there is none
+static bool firstOpenCell(const NavGrid& grid, NavPoint from, NavPoint to, NavPoint& found)
+{
+  int steps = std::max(std::abs(to.x - from.x), std::abs(to.y - from.y));
+  for (int k = 0; k <= steps; k++) {
+    NavPoint cell = from;
+    if (steps > 0) {
+      cell.x += (to.x - from.x) * k / steps;
+      cell.y += (to.y - from.y) * k / steps;
+    }
+    if (grid.walkable(cell.x, cell.y)) {
+      found = cell;
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint64_t cacheKey(NavPoint start, NavPoint goal)
+{
+  return (static_cast<uint64_t>(start.y) << 48) | (static_cast<uint64_t>(start.x) << 32) | (static_cast<uint64_t>(goal.y) << 16) | static_cast<uint64_t>(goal.x);
+}
+
+static uint64_t fieldKey(NavPoint goal)
+{
+  return (static_cast<uint64_t>(goal.y) << 16) | static_cast<uint64_t>(goal.x);
+}
+
+PathService::PathService(size_t workerCount, std::chrono::microseconds searchBudget) :
+  budget(searchBudget), snapshot(std::make_shared<const NavGrid>()), version(0), workers(std::max<size_t>(workerCount, 1)) {}
+
+void PathService::rebuild(const EntityStore& entities, int cols, int rows, int cellSize, int clearance) {
+  grid.resize(cols, rows, cellSize, clearance);
+  for (int i = 0; i < entities.size(); i++) {
+    if (entities.types[i] != EntityType::Troop) {
+      grid.addObstacle(entities.xs[i], entities.ys[i], entities.radii[i]);
+    }
+  }
+  publish();
+}
+
+void PathService::structureAdded(int x, int y, int radius) {
+  grid.addObstacle(x, y, radius);
+  publish();
+}
+
+void PathService::structureRemoved(int x, int y, int radius) {
+  grid.removeObstacle(x, y, radius);
+  publish();
+}
+
+// Searches already running keep their old copy, their answers are still
+// delivered but no longer cached
+void PathService::publish() {
+  std::shared_ptr<const NavGrid> copy = std::make_shared<const NavGrid>(grid);
+  std::scoped_lock<std::mutex> lock(mutex);
+  snapshot = std::move(copy);
+  version++;
+  cache.clear();
+  fields.clear();
+}
+
+void PathService::request(EntityHandle unit, NavPoint from, NavPoint to) {
+  PathResult result;
+  result.unit = unit;
+  result.goal = to;
+  result.status = PathStatus::Found;
+  result.cached = false;
+
+  std::shared_ptr<const NavGrid> current;
+  uint64_t currentVersion;
+  {
+    std::scoped_lock<std::mutex> lock(mutex);
+    auto it = cache.find(cacheKey(snapshot->cellOf(from.x, from.y), snapshot->cellOf(to.x, to.y)));
+    if (it != cache.end()) {
+      result.cached = true;
+      toTiles(*snapshot, it->second, result);
+      finished.push_back(std::move(result));
+      return;
+    }
+    current = snapshot;
+    currentVersion = version;
+  }
+  workers.enqueue([this, result, current, currentVersion, from]() mutable {
+    search(std::move(result), std::move(current), currentVersion, from);
+  });
+}
+
+void PathService::requestGroup(const std::vector<EntityHandle>& units, NavPoint to) {
+  std::shared_ptr<const NavGrid> current;
+  uint64_t currentVersion;
+  {
+    std::scoped_lock<std::mutex> lock(mutex);
+    auto it = fields.find(fieldKey(snapshot->cellOf(to.x, to.y)));
+    if (it != fields.end()) {
+      for (EntityHandle unit : units) {
+        PathResult result;
+        result.unit = unit;
+        result.goal = to;
+        result.status = PathStatus::Found;
+        result.cached = true;
+        result.field = it->second;
+        finished.push_back(std::move(result));
+      }
+      return;
+    }
+    current = snapshot;
+    currentVersion = version;
+  }
+  workers.enqueue([this, units, to, current, currentVersion]() mutable {
+    buildField(std::move(units), to, std::move(current), currentVersion);
+  });
+}
+
+void PathService::buildField(std::vector<EntityHandle> units, NavPoint to, std::shared_ptr<const NavGrid> navGrid, uint64_t fieldVersion) {
+  NavPoint goalCell = navGrid->cellOf(to.x, to.y);
+  std::shared_ptr<const FlowField> field = std::make_shared<const FlowField>(std::move(navGrid), goalCell);
+
+  std::scoped_lock<std::mutex> lock(mutex);
+  if (fieldVersion == version) {
+    if (fields.size() >= MAX_CACHED_FIELDS) fields.clear();
+    fields[fieldKey(goalCell)] = field;
+  }
+  for (EntityHandle unit : units) {
+    PathResult result;
+    result.unit = unit;
+    result.goal = to;
+    result.status = PathStatus::Found;
+    result.cached = false;
+    result.field = field;
+    finished.push_back(std::move(result));
+  }
+}
+
+void PathService::search(PathResult result, std::shared_ptr<const NavGrid> navGrid, uint64_t searchVersion, NavPoint from) {
+  NavPoint startCell = navGrid->cellOf(from.x, from.y);
+  NavPoint goalCell = navGrid->cellOf(result.goal.x, result.goal.y);
+  uint64_t key = cacheKey(startCell, goalCell);
+
+  // A unit standing next to a structure, or sent into one, starts or ends
+  // on the first open cell on the way
+  std::vector<NavPoint> cells;
+  NavPoint start;
+  NavPoint goal;
+  if (!firstOpenCell(*navGrid, startCell, goalCell, start) || !firstOpenCell(*navGrid, goalCell, startCell, goal)) {
+    result.status = PathStatus::NoPath;
+  } else {
+    cells.push_back(start);
+    result.status = findPath(*navGrid, start, goal, budget, cells);
+  }
+
+  std::scoped_lock<std::mutex> lock(mutex);
+  if (result.status == PathStatus::Found) {
+    toTiles(*navGrid, cells, result);
+    if (searchVersion == version) {
+      if (cache.size() >= MAX_CACHED_PATHS) cache.clear();
+      cache[key] = std::move(cells);
+    }
+  }
+  finished.push_back(std::move(result));
+}
+
+void PathService::toTiles(const NavGrid& navGrid, const std::vector<NavPoint>& cells, PathResult& result) {
+  result.waypoints.clear();
+  for (const NavPoint& cell : cells) {
+    result.waypoints.push_back(navGrid.centerOf(cell));
+  }
+  if (result.waypoints.empty() || result.waypoints.back() != result.goal) {
+    result.waypoints.push_back(result.goal);
+  }
+}
+
+void PathService::collect(std::vector<PathResult>& out) {
+  std::scoped_lock<std::mutex> lock(mutex);
+  if (finished.empty()) return;
+  for (PathResult& result : finished) {
+    out.push_back(std::move(result));
+  }
+  finished.clear();
+}
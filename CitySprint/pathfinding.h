@@ -0,0 +1,141 @@
+#ifndef PATHFINDING_H
+#define PATHFINDING_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "entity_store.h"
+#include "thread_pool.h"
+
+// A tile, or a cell of a NavGrid, depending on context
+struct NavPoint {
+  int x{};
+  int y{};
+
+  bool operator==(const NavPoint& other) const { return x == other.x && y == other.y; }
+  bool operator!=(const NavPoint& other) const { return !(*this == other); }
+};
+
+// Downsampled walkability map of the board. Each cell covers cellSize x
+// cellSize tiles and is blocked while a structure, grown by the clearance
+// a troop needs, reaches any of its tiles. A troop whose midpoint stays on
+// open cells therefore never runs into a structure.
+class NavGrid {
+public:
+  NavGrid();
+  void resize(int cols, int rows, int cellSize, int clearance);
+  void addObstacle(int x, int y, int radius);
+  void removeObstacle(int x, int y, int radius);
+
+  int cols() const { return cellsWide; }
+  int rows() const { return cellsHigh; }
+  int tilesPerCell() const { return cellSize; }
+  bool walkable(int cx, int cy) const {
+    return cx >= 0 && cy >= 0 && cx < cellsWide && cy < cellsHigh && blockers[cy * cellsWide + cx] == 0;
+  }
+
+  // Cell holding a tile, tiles off the board map to the edge cells
+  NavPoint cellOf(int x, int y) const;
+  // Tile in the middle of a cell
+  NavPoint centerOf(NavPoint cell) const;
+
+private:
+  void mark(int x, int y, int radius, int delta);
+
+  int width;
+  int height;
+  int cellSize;
+  int clearance;
+  int cellsWide;
+  int cellsHigh;
+  std::vector<uint16_t> blockers; // Structures reaching each cell
+};
+
+enum class PathStatus : uint8_t {
+  Found,
+  NoPath,
+  TimedOut
+};
+
+// Jump point search on an 8-connected grid that never cuts a blocked
+// corner. start and goal must be walkable. Appends the jump points after
+// start, ending with goal; consecutive points always lie on one straight
+// or diagonal line. Gives up once budget has passed.
+PathStatus findPath(const NavGrid& grid, NavPoint start, NavPoint goal, std::chrono::microseconds budget, std::vector<NavPoint>& out);
+
+// Integration field toward one goal cell over a whole NavGrid. Every
+// reachable cell points at its neighbour on a shortest way to the goal,
+// so any number of units heading there can each look up their next step
+// in O(1). Cells inside the structure covering the goal, if any, are
+// integrated as well, which leads units up to it and then straight in.
+class FlowField {
+public:
+  FlowField(std::shared_ptr<const NavGrid> grid, NavPoint goalCell);
+
+  NavPoint goalCell() const { return goal; }
+  // Tile to walk to next from (x, y) on the way to goal: the middle of the
+  // next cell, or goal itself once in the goal cell. Off the field, one
+  // cell straight toward goal.
+  NavPoint next(int x, int y, NavPoint goal) const;
+
+private:
+  std::shared_ptr<const NavGrid> grid; // The snapshot the field was built on
+  NavPoint goal;
+  std::vector<int8_t> directions; // Neighbour toward the goal per cell, -1 at the goal or off the field
+};
+
+struct PathResult {
+  EntityHandle unit;
+  NavPoint goal;                   // Tile the unit was sent to
+  PathStatus status;
+  bool cached;                     // Answered from an earlier search
+  std::vector<NavPoint> waypoints; // Tiles to walk to in order, ending at goal
+  std::shared_ptr<const FlowField> field; // Group orders follow this instead of waypoints
+};
+
+// Finds paths for move orders on worker threads, so a tick never waits on
+// a search. Structures are mirrored into a NavGrid; every change publishes
+// an immutable copy for the searches to read and drops the cached paths.
+// Paths are cached by start and goal cell, so repeated orders from one
+// area to another reuse the first search. Group orders share one flow
+// field per goal cell instead, kept until the structures change.
+class PathService {
+public:
+  PathService(size_t workerCount, std::chrono::microseconds budget);
+
+  // Structure changes, made by the simulation thread only
+  void rebuild(const EntityStore& entities, int cols, int rows, int cellSize, int clearance);
+  void structureAdded(int x, int y, int radius);
+  void structureRemoved(int x, int y, int radius);
+
+  // Queues a search from one tile to another. Never blocks on a search.
+  void request(EntityHandle unit, NavPoint from, NavPoint to);
+  // Queues one flow field for a group of units sent to the same tile
+  void requestGroup(const std::vector<EntityHandle>& units, NavPoint to);
+  // Moves every finished result into out
+  void collect(std::vector<PathResult>& out);
+
+private:
+  void publish();
+  void search(PathResult result, std::shared_ptr<const NavGrid> snapshot, uint64_t version, NavPoint from);
+  void buildField(std::vector<EntityHandle> units, NavPoint to, std::shared_ptr<const NavGrid> snapshot, uint64_t version);
+  static void toTiles(const NavGrid& grid, const std::vector<NavPoint>& cells, PathResult& result);
+
+  NavGrid grid; // Only touched by the thread making structure changes
+  std::chrono::microseconds budget;
+
+  std::mutex mutex; // Guards everything below
+  std::shared_ptr<const NavGrid> snapshot;
+  uint64_t version;
+  std::unordered_map<uint64_t, std::vector<NavPoint>> cache; // Path cells by start and goal cell
+  std::unordered_map<uint64_t, std::shared_ptr<const FlowField>> fields; // Flow fields by goal cell
+  std::vector<PathResult> finished;
+
+  ThreadPool workers; // Declared last so its threads stop before the rest goes away
+};
+
+#endif // PATHFINDING_H
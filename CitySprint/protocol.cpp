@@ -0,0 +1,188 @@
+#include "protocol.h"
+#include "palette.h"
+
+#include <algorithm>
+
+// Collapses consecutive tiles of one color into runs as they are appended
+class RunWriter {
+public:
+  RunWriter(std::string& out) : out(out), cursor(0), runStart(0), runLength(0), runColor(0) {}
+
+  void add(uint32_t index, ColorIndex color) {
+    if (runLength > 0 && index == runStart + runLength && color == runColor) {
+      runLength++;
+      return;
+    }
+    flush();
+    runStart = index;
+    runLength = 1;
+    runColor = color;
+  }
+
+  void flush() {
+    if (runLength == 0) return;
+    uint32_t gap = runStart - cursor;
+    bool isRun = runLength > 1;
+    appendVarint(out, (gap << 1) | (isRun ? 1 : 0));
+    if (isRun) {
+      appendVarint(out, runLength - 2);
+    }
+    out.push_back(static_cast<char>(runColor));
+    cursor = runStart + runLength;
+    runLength = 0;
+  }
+
+private:
+  std::string& out;
+  uint32_t cursor;
+  uint32_t runStart;
+  uint32_t runLength;
+  ColorIndex runColor;
+};
+
+void appendVarint(std::string& out, uint32_t value)
+{
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+std::string encodePaletteBinary()
+{
+  ColorRegistry& registry = ColorRegistry::getInstance();
+  int count = registry.size();
+
+  std::string result;
+  result.push_back(static_cast<char>(MESSAGE_PALETTE));
+  appendVarint(result, count);
+  for (int i = 0; i < count; i++) {
+    const std::string& name = registry.nameOf(static_cast<ColorIndex>(i));
+    appendVarint(result, static_cast<uint32_t>(name.size()));
+    result += name;
+  }
+  return result;
+}
+
+// Tiles must be in row-major order, which is how Board::collectDirtyTiles emits them
+std::string encodeTilesBinary(const std::vector<Tile>& tiles, int cols, int rows)
+{
+  std::string result;
+  result.reserve(16 + tiles.size() * 3);
+  result.push_back(static_cast<char>(MESSAGE_BOARD_DELTA));
+  appendVarint(result, cols);
+  appendVarint(result, rows);
+
+  RunWriter writer(result);
+  for (const auto& tile : tiles) {
+    writer.add(static_cast<uint32_t>(tile.y) * cols + tile.x, tile.color);
+  }
+  writer.flush();
+  return result;
+}
+
+std::string encodeKeyframeHeaderBinary(const Board& board)
+{
+  std::string result;
+  result.push_back(static_cast<char>(MESSAGE_BOARD_KEYFRAME));
+  appendVarint(result, board.cols());
+  appendVarint(result, board.rows());
+  appendVarint(result, CHUNK_SHIFT);
+  return result;
+}
+
+// Writes the square of side size at (x, y) inside a chunk as quadtree nodes
+static void appendQuadtree(std::string& out, const ColorIndex* tiles, int x, int y, int size)
+{
+  ColorIndex color = tiles[(y << CHUNK_SHIFT) | x];
+  bool uniform = true;
+  for (int row = y; row < y + size && uniform; row++) {
+    const ColorIndex* line = tiles + (row << CHUNK_SHIFT) + x;
+    for (int i = 0; i < size; i++) {
+      if (line[i] != color) {
+        uniform = false;
+        break;
+      }
+    }
+  }
+
+  if (uniform) {
+    out.push_back(static_cast<char>(color));
+    return;
+  }
+  int half = size / 2;
+  out.push_back(static_cast<char>(QUADTREE_SPLIT));
+  appendQuadtree(out, tiles, x, y, half);
+  appendQuadtree(out, tiles, x + half, y, half);
+  appendQuadtree(out, tiles, x, y + half, half);
+  appendQuadtree(out, tiles, x + half, y + half, half);
+}
+
+// One keyframe record, or nothing if the chunk was never drawn into
+std::string encodeChunkBinary(const Board& board, int cx, int cy)
+{
+  const ColorIndex* tiles = board.chunkTiles(cx, cy);
+  if (!tiles) return "";
+
+  std::string runs;
+  RunWriter writer(runs);
+  for (uint32_t index = 0; index < CHUNK_AREA; index++) {
+    writer.add(index, tiles[index]);
+  }
+  writer.flush();
+
+  std::string quadtree;
+  appendQuadtree(quadtree, tiles, 0, 0, CHUNK_SIZE);
+
+  bool useQuadtree = quadtree.size() < runs.size();
+  const std::string& payload = useQuadtree ? quadtree : runs;
+
+  std::string result;
+  appendVarint(result, board.chunkIndex(cx, cy));
+  result.push_back(static_cast<char>(useQuadtree ? CHUNK_ENCODING_QUADTREE : CHUNK_ENCODING_RLE));
+  appendVarint(result, static_cast<uint32_t>(payload.size()));
+  result += payload;
+  return result;
+}
+
+// Appends a single "x,y,color;" entry without building temporaries
+static void appendTileToString(std::string& result, int x, int y, ColorIndex color)
+{
+  result += std::to_string(x);
+  result += ',';
+  result += std::to_string(y);
+  result += ',';
+  result += colorName(color);
+  result += ';';
+}
+
+std::string serializeTilesToString(const std::vector<Tile>& tiles)
+{
+  std::string result;
+  result.reserve(tiles.size() * 16);
+  result += TEXT_BOARD_PREFIX;
+  for (const auto& tile : tiles) {
+    appendTileToString(result, tile.x, tile.y, tile.color);
+  }
+  result += TEXT_BOARD_SUFFIX;
+  return result;
+}
+
+// Every tile of the chunk that lies on the board, without the envelope
+std::string serializeChunkToString(const Board& board, int cx, int cy)
+{
+  int x0 = cx << CHUNK_SHIFT;
+  int y0 = cy << CHUNK_SHIFT;
+  int x1 = std::min(x0 + CHUNK_SIZE, board.cols());
+  int y1 = std::min(y0 + CHUNK_SIZE, board.rows());
+
+  std::string result;
+  result.reserve(static_cast<size_t>(CHUNK_AREA) * 16);
+  for (int y = y0; y < y1; y++) {
+    for (int x = x0; x < x1; x++) {
+      appendTileToString(result, x, y, board.get(x, y));
+    }
+  }
+  return result;
+}
@@ -0,0 +1,55 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "board.h"
+
+// Subprotocol a client requests in its handshake to receive binary board frames
+const std::string BINARY_SUBPROTOCOL = "citysprint-binary";
+
+// First byte of every binary message
+const uint8_t MESSAGE_PALETTE = 0x01;     // Palette index -> color name table
+const uint8_t MESSAGE_BOARD_DELTA = 0x02; // Runs of changed tiles
+const uint8_t MESSAGE_BOARD_KEYFRAME = 0x03; // Whole board, chunk by chunk
+
+// How a keyframe chunk is encoded, whichever is smaller is chosen per chunk
+const uint8_t CHUNK_ENCODING_RLE = 0x00;      // Row-major runs, same as deltas
+const uint8_t CHUNK_ENCODING_QUADTREE = 0x01; // Region quadtree
+
+// Quadtree node that splits into four children; never a real color since
+// the transparent index does not reach the composited board
+const uint8_t QUADTREE_SPLIT = TRANSPARENT_COLOR;
+
+// Binary board messages sent in WebSocket binary frames.
+//
+// Integers are unsigned LEB128 varints. A board delta is
+//   [MESSAGE_BOARD_DELTA][cols][rows] followed by runs, where each run is
+//   [(gap << 1) | isRun][length - 2, only if isRun][palette byte]
+// and gap is the distance in row-major tile index from the end of the
+// previous run. A single changed tile therefore costs 2-4 bytes, and long
+// stretches of one color cost the same as a single tile.
+//
+// A keyframe is [MESSAGE_BOARD_KEYFRAME][cols][rows][chunk shift] followed
+// by one record per allocated chunk: [chunk index][encoding][byte length]
+// [payload]. Chunks that are missing are background. An RLE payload is runs
+// with positions local to the chunk. A quadtree payload is the nodes in
+// depth-first order: a palette byte for a uniform square, or QUADTREE_SPLIT
+// followed by the top-left, top-right, bottom-left and bottom-right halves.
+// Large uniform regions such as the background or a solid circle's interior
+// collapse to a handful of bytes either way.
+void appendVarint(std::string& out, uint32_t value);
+std::string encodePaletteBinary();
+std::string encodeTilesBinary(const std::vector<Tile>& tiles, int cols, int rows);
+std::string encodeKeyframeHeaderBinary(const Board& board);
+std::string encodeChunkBinary(const Board& board, int cx, int cy);
+
+// Text protocol, a list of "x,y,color;" entries inside a JSON-ish envelope
+const std::string TEXT_BOARD_PREFIX = "{\"game\": { \"board\": \"";
+const std::string TEXT_BOARD_SUFFIX = "\"}}";
+std::string serializeTilesToString(const std::vector<Tile>& tiles);
+std::string serializeChunkToString(const Board& board, int cx, int cy);
+
+#endif // PROTOCOL_H
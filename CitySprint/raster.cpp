@@ -0,0 +1,70 @@
+#include "raster.h"
+
+#include <map>
+#include <mutex>
+
+static std::map<int, CircleStamp> stampCache;
+static std::mutex stampCacheMutex;
+
+// Runs the Bresenham circle once into a mask and turns each row into spans
+static CircleStamp buildCircleStamp(int radius)
+{
+  int side = 2 * radius + 1;
+  std::vector<char> mask(static_cast<size_t>(side) * side, 0);
+  auto plot = [&](int x, int y) { mask[(y + radius) * side + (x + radius)] = 1; };
+
+  int d = 3 - 2 * radius;
+  int y = radius;
+  int x = 0;
+  while (y >= x) {
+    plot(x, y);
+    plot(-x, y);
+    plot(x, -y);
+    plot(-x, -y);
+    plot(y, x);
+    plot(-y, x);
+    plot(y, -x);
+    plot(-y, -x);
+
+    x++;
+    if (d > 0) {
+      y--;
+      d = d + 4 * (x - y) + 10;
+    } else {
+      d = d + 4 * x + 6;
+    }
+  }
+
+  CircleStamp stamp;
+  stamp.radius = radius;
+  for (int dy = -radius; dy <= radius; dy++) {
+    const char* row = &mask[(dy + radius) * side];
+    int first = -1;
+    int last = -1;
+    int runStart = 0;
+    for (int i = 0; i < side; i++) {
+      if (!row[i]) continue;
+      if (first < 0) first = i;
+      last = i;
+      // Each contiguous run of outline pixels becomes one span
+      if (i == 0 || !row[i - 1]) runStart = i;
+      if (i + 1 == side || !row[i + 1]) {
+        stamp.outline.push_back({ dy, runStart - radius, i - radius });
+      }
+    }
+    if (first >= 0) {
+      stamp.filled.push_back({ dy, first - radius, last - radius });
+    }
+  }
+  return stamp;
+}
+
+const CircleStamp& circleStamp(int radius)
+{
+  std::scoped_lock<std::mutex> lock(stampCacheMutex);
+  auto it = stampCache.find(radius);
+  if (it == stampCache.end()) {
+    it = stampCache.emplace(radius, buildCircleStamp(radius)).first;
+  }
+  return it->second;
+}
@@ -0,0 +1,30 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <vector>
+
+enum class StampMode {
+  Filled,
+  Outline
+};
+
+// One horizontal run of a circle, offsets relative to the center
+struct Span {
+  int dy;
+  int x0;
+  int x1;
+};
+
+// Precomputed rows of a circle of one radius. The outline matches the
+// Bresenham circle the game has always drawn; the filled stamp covers
+// everything inside it.
+struct CircleStamp {
+  int radius{};
+  std::vector<Span> filled;
+  std::vector<Span> outline;
+};
+
+// Returns the cached stamp for a radius, building it on first use
+const CircleStamp& circleStamp(int radius);
+
+#endif // RASTER_H
@@ -0,0 +1,83 @@
+#include "spatial_grid.h"
+
+SpatialGrid::SpatialGrid(std::pmr::memory_resource* resource) : width(0), height(0), cellSize(1), cellsWide(0), cellsHigh(0), maxRadius(0), cells(resource), changedAt(resource), changes(0) {}
+
+void SpatialGrid::resize(int cols, int rows, int size) {
+  width = std::max(cols, 1);
+  height = std::max(rows, 1);
+  cellSize = std::max(size, 1);
+  cellsWide = (width + cellSize - 1) / cellSize;
+  cellsHigh = (height + cellSize - 1) / cellSize;
+  cells.clear();
+  cells.resize(static_cast<size_t>(cellsWide) * cellsHigh);
+  changedAt.assign(cells.size(), 0);
+}
+
+void SpatialGrid::clear() {
+  for (auto& cell : cells) {
+    cell.slots.clear();
+    cell.xs.clear();
+    cell.ys.clear();
+    cell.radii.clear();
+  }
+}
+
+void SpatialGrid::insert(uint32_t slot, int x, int y, int radius) {
+  maxRadius = std::max(maxRadius, radius);
+  if (cells.empty()) return;
+  int index = cellIndex(x, y);
+  GridCell& cell = cells[index];
+  changedAt[index] = ++changes;
+  cell.slots.push_back(slot);
+  cell.xs.push_back(x);
+  cell.ys.push_back(y);
+  cell.radii.push_back(radius);
+}
+
+// Moves the cell's last entry into the freed one
+void SpatialGrid::removeAt(GridCell& cell, int entry) {
+  int last = cell.size() - 1;
+  cell.slots[entry] = cell.slots[last];
+  cell.xs[entry] = cell.xs[last];
+  cell.ys[entry] = cell.ys[last];
+  cell.radii[entry] = cell.radii[last];
+  cell.slots.pop_back();
+  cell.xs.pop_back();
+  cell.ys.pop_back();
+  cell.radii.pop_back();
+}
+
+void SpatialGrid::remove(uint32_t slot, int x, int y) {
+  if (cells.empty()) return;
+  int index = cellIndex(x, y);
+  GridCell& cell = cells[index];
+  auto it = std::find(cell.slots.begin(), cell.slots.end(), slot);
+  if (it != cell.slots.end()) {
+    removeAt(cell, static_cast<int>(it - cell.slots.begin()));
+    changedAt[index] = ++changes;
+  }
+}
+
+void SpatialGrid::move(uint32_t slot, int oldX, int oldY, int x, int y) {
+  if (cells.empty()) return;
+  int fromIndex = cellIndex(oldX, oldY);
+  GridCell& from = cells[fromIndex];
+  auto it = std::find(from.slots.begin(), from.slots.end(), slot);
+  if (it == from.slots.end()) return;
+  int entry = static_cast<int>(it - from.slots.begin());
+  int toIndex = cellIndex(x, y);
+  GridCell& to = cells[toIndex];
+  changedAt[fromIndex] = ++changes;
+  changedAt[toIndex] = changes;
+  if (&from == &to) {
+    from.xs[entry] = x;
+    from.ys[entry] = y;
+    return;
+  }
+  int radius = from.radii[entry];
+  removeAt(from, entry);
+  to.slots.push_back(slot);
+  to.xs.push_back(x);
+  to.ys.push_back(y);
+  to.radii.push_back(radius);
+}
@@ -0,0 +1,117 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// One grid cell. Each entry's midpoint and radius are kept next to its slot
+// as separate arrays so the narrow phase can test a whole cell in one batch.
+// Takes its memory from the same resource as the grid.
+struct GridCell {
+  typedef std::pmr::polymorphic_allocator<GridCell> allocator_type;
+
+  explicit GridCell(const allocator_type& alloc = {}) : slots(alloc), xs(alloc), ys(alloc), radii(alloc) {}
+  GridCell(const GridCell& other, const allocator_type& alloc) : slots(other.slots, alloc), xs(other.xs, alloc), ys(other.ys, alloc), radii(other.radii, alloc) {}
+  GridCell(GridCell&& other, const allocator_type& alloc) : slots(std::move(other.slots), alloc), xs(std::move(other.xs), alloc), ys(std::move(other.ys), alloc), radii(std::move(other.radii), alloc) {}
+  GridCell(const GridCell& other) = default;
+  GridCell(GridCell&& other) = default;
+  GridCell& operator=(const GridCell& other) = default;
+  GridCell& operator=(GridCell&& other) = default;
+
+  std::pmr::vector<uint32_t> slots;
+  std::pmr::vector<int> xs;
+  std::pmr::vector<int> ys;
+  std::pmr::vector<int> radii;
+
+  int size() const { return static_cast<int>(slots.size()); }
+};
+
+// Uniform grid over the board that buckets entity slots by the cell their
+// midpoint falls in. Cells are sized to the largest entity radius, so a
+// circle query only has to visit the few cells around it no matter how
+// many entities exist. Midpoints off the board are kept in the edge cells.
+class SpatialGrid {
+public:
+  explicit SpatialGrid(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+  void resize(int cols, int rows, int cellSize);
+  void clear();
+
+  void insert(uint32_t slot, int x, int y, int radius);
+  void remove(uint32_t slot, int x, int y);
+  void move(uint32_t slot, int oldX, int oldY, int x, int y);
+
+  // Cell a midpoint falls in, -1 before the grid is sized
+  int cellIndex(int x, int y) const { return cells.empty() ? -1 : cellY(y) * cellsWide + cellX(x); }
+
+  // Largest radius ever inserted, how far beyond a query circle to look
+  int largestRadius() const { return maxRadius; }
+
+  // Counts every insert, removal and move. Each cell remembers the count at
+  // its last change, so a caller that saw nothing near a point can tell
+  // whether anything there has changed since.
+  uint64_t version() const { return changes; }
+  uint64_t changedNear(int x, int y, int reach) const {
+    uint64_t latest = 0;
+    if (cells.empty()) return latest;
+    for (int cy = cellY(y - reach); cy <= cellY(y + reach); cy++) {
+      for (int cx = cellX(x - reach); cx <= cellX(x + reach); cx++) {
+        latest = std::max(latest, changedAt[cy * cellsWide + cx]);
+      }
+    }
+    return latest;
+  }
+
+  // Reach at which forEachNear from (x, y) visits every cell
+  int fullReach(int x, int y) const {
+    return std::max(std::abs(x), std::abs(x - width)) + std::max(std::abs(y), std::abs(y - height));
+  }
+
+  // Calls visit(slot) for every entry in the cells within reach of (x, y)
+  // until visit returns false
+  template <typename Visit>
+  void forEachNear(int x, int y, int reach, Visit visit) const {
+    forEachCellNear(x, y, reach, [&](const GridCell& cell) {
+      for (uint32_t slot : cell.slots) {
+        if (!visit(slot)) return false;
+      }
+      return true;
+    });
+  }
+
+  // Calls visit(cell) for every non-empty cell within reach of (x, y)
+  // until visit returns false
+  template <typename Visit>
+  void forEachCellNear(int x, int y, int reach, Visit visit) const {
+    if (cells.empty()) return;
+    int cx0 = cellX(x - reach);
+    int cx1 = cellX(x + reach);
+    int cy0 = cellY(y - reach);
+    int cy1 = cellY(y + reach);
+    for (int cy = cy0; cy <= cy1; cy++) {
+      for (int cx = cx0; cx <= cx1; cx++) {
+        const GridCell& cell = cells[cy * cellsWide + cx];
+        if (!cell.slots.empty() && !visit(cell)) return;
+      }
+    }
+  }
+
+private:
+  int cellX(int x) const { return std::min(std::max(x, 0), width - 1) / cellSize; }
+  int cellY(int y) const { return std::min(std::max(y, 0), height - 1) / cellSize; }
+  static void removeAt(GridCell& cell, int entry);
+
+  int width;
+  int height;
+  int cellSize;
+  int cellsWide;
+  int cellsHigh;
+  int maxRadius;
+  std::pmr::vector<GridCell> cells;
+  std::pmr::vector<uint64_t> changedAt; // Per cell, the change count when it last changed
+  uint64_t changes;
+};
+
+#endif // SPATIAL_GRID_H
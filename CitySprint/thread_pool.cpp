@@ -0,0 +1,45 @@
+#include "thread_pool.h"
+
+#include <iostream>
+#include <string>
+
+ThreadPool::ThreadPool(size_t numThreads) : stop(false) 
+{
+  std::cout << "Initializing Thread Pool with: " << std::to_string(numThreads) << " Worker Threads." << std::endl;
+  for (size_t i = 0; i < numThreads; ++i) {
+    workers.emplace_back([this] {
+      for (;;) {
+        std::function<void()> task;
+
+        {
+          std::unique_lock<std::mutex> lock(this->queueMutex);
+          this->condition.wait(lock, [this] { return this->stop || !this->tasks.empty(); });
+          if (this->stop && this->tasks.empty()) return;
+          task = std::move(this->tasks.front());
+          this->tasks.pop();
+        }
+
+        task();
+      }
+    });
+  }
+}
+
+ThreadPool::~ThreadPool() 
+{
+  {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    stop = true;
+  }
+  condition.notify_all();
+  for (std::thread &worker : workers) worker.join();
+}
+
+void ThreadPool::enqueue(std::function<void()> task) 
+{
+  {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    tasks.push(std::move(task));
+  }
+  condition.notify_one();
+}
@@ -0,0 +1,28 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running queued tasks in order
+class ThreadPool {
+public:
+  ThreadPool(size_t numThreads);
+  ~ThreadPool();
+
+  void enqueue(std::function<void()> task);
+
+private:
+  std::vector<std::thread> workers;
+  std::queue<std::function<void()>> tasks;
+
+  std::mutex queueMutex;
+  std::condition_variable condition;
+  bool stop;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,95 @@
+#include "tick_scheduler.h"
+#include "utilities.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+const char* tickPhaseName(TickPhase phase)
+{
+  switch (phase) {
+  case TickPhase::Input: return "input";
+  case TickPhase::Movement: return "movement";
+  case TickPhase::Combat: return "combat";
+  case TickPhase::Economy: return "economy";
+  case TickPhase::Broadcast: return "broadcast";
+  }
+  return "unknown";
+}
+
+TickScheduler::TickScheduler(int ticksPerSecond, int maxCatchUp) :
+  tickPeriod(std::chrono::nanoseconds(std::chrono::seconds(1)) / std::max(ticksPerSecond, 1)),
+  maxCatchUp(std::max(maxCatchUp, 1)),
+  started(false) {}
+
+void TickScheduler::setPhase(TickPhase phase, std::function<void()> work) {
+  phases[static_cast<int>(phase)] = std::move(work);
+}
+
+void TickScheduler::setReport(std::function<std::string()> report) {
+  gameReport = std::move(report);
+}
+
+void TickScheduler::runPhase(TickPhase phase) {
+  std::function<void()>& work = phases[static_cast<int>(phase)];
+  if (!work) return;
+  auto start = std::chrono::steady_clock::now();
+  work();
+  tickStats.phaseDurations[static_cast<int>(phase)] += std::chrono::steady_clock::now() - start;
+}
+
+void TickScheduler::runOnce() {
+  if (!started) {
+    deadline = std::chrono::steady_clock::now();
+    started = true;
+  }
+  std::this_thread::sleep_until(deadline);
+
+  auto wake = std::chrono::steady_clock::now();
+  tickStats.maxLateness = std::max(tickStats.maxLateness, std::chrono::duration_cast<std::chrono::nanoseconds>(wake - deadline));
+
+  // One step per period that has come due since the last wake-up
+  int steps = 0;
+  while (deadline <= wake && steps < maxCatchUp) {
+    runPhase(TickPhase::Input);
+    runPhase(TickPhase::Movement);
+    runPhase(TickPhase::Combat);
+    runPhase(TickPhase::Economy);
+    deadline += tickPeriod;
+    steps++;
+  }
+  tickStats.ticks += steps;
+  if (steps > 1) tickStats.catchUps += steps - 1;
+  if (deadline <= wake) {
+    // Too far behind, give up on the missed steps instead of spiralling
+    uint64_t missed = (wake - deadline) / tickPeriod + 1;
+    tickStats.dropped += missed;
+    deadline += tickPeriod * missed;
+  }
+  runPhase(TickPhase::Broadcast);
+
+  auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wake);
+  tickStats.lastDuration = duration;
+  tickStats.maxDuration = std::max(tickStats.maxDuration, duration);
+  tickStats.totalDuration += duration;
+  if (duration > tickPeriod) {
+    tickStats.overruns++;
+  }
+}
+
+void TickScheduler::run(int reportSeconds) {
+  uint64_t reportEvery = std::max<uint64_t>(std::chrono::seconds(reportSeconds) / tickPeriod, 1);
+  uint64_t nextReport = reportEvery;
+  while (true) {
+    runOnce();
+    if (tickStats.ticks < nextReport) continue;
+    nextReport = tickStats.ticks + reportEvery;
+
+    auto micros = [](std::chrono::nanoseconds time) { return std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(time).count()); };
+    std::string phaseTimes;
+    for (int i = 0; i < TICK_PHASE_COUNT; i++) {
+      phaseTimes += std::string(i ? ", " : "") + tickPhaseName(static_cast<TickPhase>(i)) + " " + micros(tickStats.phaseDurations[i] / tickStats.ticks);
+    }
+    log("Ticks: " + std::to_string(tickStats.ticks) + " run, " + std::to_string(tickStats.catchUps) + " caught up, " + std::to_string(tickStats.dropped) + " dropped, " + std::to_string(tickStats.overruns) + " overruns. Work max " + micros(tickStats.maxDuration) + " us, latest wake " + micros(tickStats.maxLateness) + " us late. Average us per tick: " + phaseTimes + "." + (gameReport ? " " + gameReport() : std::string()));
+  }
+}
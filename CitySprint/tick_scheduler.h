@@ -0,0 +1,69 @@
+#ifndef TICK_SCHEDULER_H
+#define TICK_SCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Work done in one tick, in this order
+enum class TickPhase : uint8_t {
+  Input,     // Apply what players asked for
+  Movement,  // Advance moving units
+  Combat,    // Pick targets and trade damage
+  Economy,   // Income and upkeep
+  Broadcast  // Send the tick's changes to clients
+};
+
+const int TICK_PHASE_COUNT = 5;
+
+const char* tickPhaseName(TickPhase phase);
+
+// Timing of the ticks run so far
+struct TickStats {
+  uint64_t ticks{};     // Simulation steps run
+  uint64_t catchUps{};  // Steps run back to back because the loop fell behind
+  uint64_t dropped{};   // Steps skipped because catching up would have taken too many
+  uint64_t overruns{};  // Wake-ups whose work took longer than one period
+  std::chrono::nanoseconds lastDuration{}; // Work done on the last wake-up
+  std::chrono::nanoseconds maxDuration{};
+  std::chrono::nanoseconds totalDuration{};
+  std::chrono::nanoseconds maxLateness{};  // Furthest a wake-up came after its deadline
+  std::chrono::nanoseconds phaseDurations[TICK_PHASE_COUNT]{};
+};
+
+// Runs the game at a fixed rate against a monotonic deadline that moves
+// one period per step, so the tick period no longer depends on how long
+// the work takes. When the loop wakes up late the simulation phases run
+// once per missed period, up to maxCatchUp steps; anything beyond that is
+// dropped and counted. Broadcast runs once per wake-up, after the steps.
+class TickScheduler {
+public:
+  TickScheduler(int ticksPerSecond, int maxCatchUp);
+
+  // Phases without work are skipped
+  void setPhase(TickPhase phase, std::function<void()> work);
+  // Extra text for the periodic stats line, counters the game keeps itself
+  void setReport(std::function<std::string()> report);
+
+  // Sleeps until the next deadline and runs the steps that are due
+  void runOnce();
+  // Never returns, logs the stats every reportSeconds
+  void run(int reportSeconds);
+
+  std::chrono::nanoseconds period() const { return tickPeriod; }
+  const TickStats& stats() const { return tickStats; }
+
+private:
+  void runPhase(TickPhase phase);
+
+  std::chrono::nanoseconds tickPeriod;
+  int maxCatchUp;
+  std::chrono::steady_clock::time_point deadline;
+  bool started;
+  std::function<void()> phases[TICK_PHASE_COUNT];
+  std::function<std::string()> gameReport;
+  TickStats tickStats;
+};
+
+#endif // TICK_SCHEDULER_H
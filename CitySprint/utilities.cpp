@@ -16,9 +16,9 @@ int generateUniqueId() {
   return id;
 }
 
-std::string encodeWebSocketFrame(const std::string& message) {
+std::string encodeWebSocketFrame(const std::string& message, unsigned char opcode) {
   std::string frame;
-  frame.push_back(0x81); // Text frame
+  frame.push_back(static_cast<char>(0x80 | opcode)); // FIN bit plus text or binary opcode
   if (message.size() <= 125) {
     frame.push_back(static_cast<char>(message.size()));
   }
@@ -89,18 +89,3 @@ std::string generateWebSocketAcceptKey(const std::string& key) {
   SHA1(reinterpret_cast<const unsigned char*>(acceptKey.c_str()), acceptKey.size(), hash);
   return base64Encode(hash, SHA_DIGEST_LENGTH);
 }
-
-double squareRoot(int initialNum) {
-  double numCopy = static_cast<double>(initialNum);
-
-  if (numCopy < 2)
-    return numCopy;
-
-  double z = (numCopy + (initialNum / numCopy)) / 2;
-
-  while (abs(numCopy - z) >= 0.00001) {
-    numCopy = z;
-    z = (numCopy + (initialNum / numCopy)) / 2;
-  }
-  return z;
-}
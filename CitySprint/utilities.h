@@ -3,12 +3,15 @@
 
 #include <string>
 
+// WebSocket frame opcodes
+const unsigned char WS_OPCODE_TEXT = 0x1;
+const unsigned char WS_OPCODE_BINARY = 0x2;
+
 void log(const std::string& message);
 int generateUniqueId();
-std::string encodeWebSocketFrame(const std::string& message);
+std::string encodeWebSocketFrame(const std::string& message, unsigned char opcode = WS_OPCODE_TEXT);
 std::string decodeWebSocketFrame(const std::string& frame);
 std::string base64Encode(const unsigned char* input, int length);
 std::string generateWebSocketAcceptKey(const std::string& key);
-double squareRoot(int initialNum);
 
 #endif // UTILITIES_H
@@ -2,6 +2,9 @@ const canvas = document.getElementById('gameCanvas');
 const context = canvas.getContext('2d');
 const tileSize = 2; // Update the tileSize to match server
 let gameMatrix = []; // Initialize the game matrix
+let palette = []; // Palette index -> color, sent by the server in binary mode
+let boardCols = 0; // Board size in tiles, sent with every binary board message
+let boardRows = 0;
 let selectedCharacterType = "coin";
 let selectedTroop = null;
 var jsonStuff = '{"player":{"coins":0,"troops":0}}';
@@ -16,8 +19,17 @@ var PlayerState = {
 
 const fullscrBtn = document.getElementById('fullscreenBtn');
 
-const ws = new WebSocket("ws://localhost:9001"); // For Development
-// const ws = new WebSocket("ws://<server_ip>:9001"); // For Production
+// Binary board message types, must match protocol.h on the server
+const MESSAGE_PALETTE = 0x01;
+const MESSAGE_BOARD_DELTA = 0x02;
+const MESSAGE_BOARD_KEYFRAME = 0x03;
+const CHUNK_ENCODING_RLE = 0x00;
+const CHUNK_ENCODING_QUADTREE = 0x01;
+const QUADTREE_SPLIT = 0xff;
+
+const ws = new WebSocket("ws://localhost:9001", "citysprint-binary"); // For Development
+// const ws = new WebSocket("ws://<server_ip>:9001", "citysprint-binary"); // For Production
+ws.binaryType = "arraybuffer";
 
 console.log("WS was created");
 
@@ -40,6 +52,10 @@ ws.onmessage = function (event) {
     console.log("Received keep-alive ping from server.");
     return;
   }
+  if (event.data instanceof ArrayBuffer) {
+    handleBinaryMessage(event.data);
+    return;
+  }
   handleServerMessage(event);
 };
 
@@ -198,3 +214,166 @@ function initializeGameMatrix() {
 
 // Call this function to start the game
 initializeGameMatrix();
+
+// Reads an unsigned LEB128 varint and advances the cursor
+function readVarint(view, cursor) {
+  let value = 0;
+  let scale = 1;
+  let byte;
+  do {
+    byte = view.getUint8(cursor.offset++);
+    value += (byte & 0x7f) * scale;
+    scale *= 128;
+  } while (byte & 0x80);
+  return value;
+}
+
+// Paints a run of tiles starting at a row-major index, splitting it at row ends
+function drawRun(start, length, color, cols) {
+  context.fillStyle = color;
+  while (length > 0) {
+    const yPos = Math.floor(start / cols);
+    const xPos = start % cols;
+    const count = Math.min(length, cols - xPos);
+
+    if (!gameMatrix[yPos]) {
+      gameMatrix[yPos] = [];
+    }
+    for (let i = 0; i < count; i++) {
+      gameMatrix[yPos][xPos + i] = color;
+    }
+    context.fillRect(xPos * tileSize, yPos * tileSize, count * tileSize, tileSize);
+
+    start += count;
+    length -= count;
+  }
+}
+
+// Paints a run of tiles inside one chunk, positions are local to the chunk.
+// Edge chunks are padded to full size, the padding is skipped.
+function drawChunkRun(originX, originY, chunkSize, start, length, color) {
+  context.fillStyle = color;
+  while (length > 0) {
+    const yPos = originY + Math.floor(start / chunkSize);
+    const xPos = originX + start % chunkSize;
+    const count = Math.min(length, chunkSize - start % chunkSize);
+    const visible = Math.min(count, boardCols - xPos);
+
+    if (yPos < boardRows && visible > 0) {
+      for (let i = 0; i < visible; i++) {
+        gameMatrix[yPos][xPos + i] = color;
+      }
+      context.fillRect(xPos * tileSize, yPos * tileSize, visible * tileSize, tileSize);
+    }
+
+    start += count;
+    length -= count;
+  }
+}
+
+// Paints one quadtree node and its children, depth first
+function drawQuadtree(view, cursor, xPos, yPos, size) {
+  const node = view.getUint8(cursor.offset++);
+  if (node === QUADTREE_SPLIT && size > 1) {
+    const half = size / 2;
+    drawQuadtree(view, cursor, xPos, yPos, half);
+    drawQuadtree(view, cursor, xPos + half, yPos, half);
+    drawQuadtree(view, cursor, xPos, yPos + half, half);
+    drawQuadtree(view, cursor, xPos + half, yPos + half, half);
+    return;
+  }
+  // Leaves over an edge chunk's padding are clipped to the board
+  const width = Math.min(size, boardCols - xPos);
+  const height = Math.min(size, boardRows - yPos);
+  if (width <= 0 || height <= 0) {
+    return;
+  }
+  const color = palette[node];
+  context.fillStyle = color;
+  context.fillRect(xPos * tileSize, yPos * tileSize, width * tileSize, height * tileSize);
+  for (let y = yPos; y < yPos + height; y++) {
+    for (let x = xPos; x < xPos + width; x++) {
+      gameMatrix[y][x] = color;
+    }
+  }
+}
+
+// The world size is chosen when the server starts
+function resizeBoard(cols, rows) {
+  boardCols = cols;
+  boardRows = rows;
+  if (canvas.width !== cols * tileSize || canvas.height !== rows * tileSize) {
+    canvas.width = cols * tileSize;
+    canvas.height = rows * tileSize;
+  }
+}
+
+// Decodes the binary board protocol described in protocol.h
+function handleBinaryMessage(buffer) {
+  const view = new DataView(buffer);
+  const cursor = { offset: 0 };
+  const type = view.getUint8(cursor.offset++);
+
+  if (type === MESSAGE_PALETTE) {
+    const count = readVarint(view, cursor);
+    const decoder = new TextDecoder();
+    palette = [];
+    for (let i = 0; i < count; i++) {
+      const length = readVarint(view, cursor);
+      palette.push(decoder.decode(new Uint8Array(buffer, cursor.offset, length)));
+      cursor.offset += length;
+    }
+  } else if (type === MESSAGE_BOARD_DELTA) {
+    const cols = readVarint(view, cursor);
+    const rows = readVarint(view, cursor);
+    resizeBoard(cols, rows);
+    let index = 0;
+    while (cursor.offset < view.byteLength) {
+      const header = readVarint(view, cursor);
+      const start = index + Math.floor(header / 2);
+      const length = (header & 1) ? readVarint(view, cursor) + 2 : 1;
+      const color = palette[view.getUint8(cursor.offset++)];
+      drawRun(start, length, color, cols);
+      index = start + length;
+    }
+  } else if (type === MESSAGE_BOARD_KEYFRAME) {
+    const cols = readVarint(view, cursor);
+    const rows = readVarint(view, cursor);
+    const chunkShift = readVarint(view, cursor);
+    const chunkSize = 1 << chunkShift;
+    const chunksWide = Math.ceil(cols / chunkSize);
+    resizeBoard(cols, rows);
+
+    // Chunks missing from the keyframe are plain background
+    gameMatrix = [];
+    for (let y = 0; y < rows; y++) {
+      gameMatrix.push(new Array(cols).fill(palette[0]));
+    }
+    context.fillStyle = palette[0];
+    context.fillRect(0, 0, canvas.width, canvas.height);
+
+    while (cursor.offset < view.byteLength) {
+      const chunkIndex = readVarint(view, cursor);
+      const encoding = view.getUint8(cursor.offset++);
+      const byteLength = readVarint(view, cursor);
+      const end = cursor.offset + byteLength;
+      const originX = (chunkIndex % chunksWide) * chunkSize;
+      const originY = Math.floor(chunkIndex / chunksWide) * chunkSize;
+      if (encoding === CHUNK_ENCODING_QUADTREE) {
+        drawQuadtree(view, cursor, originX, originY, chunkSize);
+        continue;
+      }
+      let index = 0;
+      while (cursor.offset < end) {
+        const header = readVarint(view, cursor);
+        const start = index + Math.floor(header / 2);
+        const length = (header & 1) ? readVarint(view, cursor) + 2 : 1;
+        const color = palette[view.getUint8(cursor.offset++)];
+        drawChunkRun(originX, originY, chunkSize, start, length, color);
+        index = start + length;
+      }
+    }
+  } else {
+    console.log("Unknown binary message type: ", type);
+  }
+}